@@ -13,6 +13,13 @@ static herr_t h5_error_handler(hid_t /*estack*/, void*)
 
 int main(int argc, char* argv[])
 {
+#ifdef H5_HAVE_PARALLEL
+    MPI_Init(&argc, &argv);
+#endif
     H5Eset_auto(H5E_DEFAULT, h5_error_handler, NULL);
-    return Catch::Session().run(argc, argv);
+    auto result = Catch::Session().run(argc, argv);
+#ifdef H5_HAVE_PARALLEL
+    MPI_Finalize();
+#endif
+    return result;
 }
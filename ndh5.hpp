@@ -1,7 +1,42 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
 #include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
 #include <vector>
 #include <hdf5.h>
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+#define NDH5_HAVE_IO_URING
+#endif
+#endif
+#endif
 //#include "../ndarray/include/ndarray.hpp"
 
 
@@ -18,33 +53,232 @@ namespace h5
     class Dataset;
     class Datatype;
     class Dataspace;
+    class PropertyList;
+    class FileOptions;
+    class DatasetOptions;
+    class GroupOptions;
+    class Schema;
+    class IOThread;
+    class Checkpoint;
+    class RolloverWriter;
+    class BurstMode;
+#ifdef __linux__
+    class ReaderPool;
+    template<typename T> class SharedView;
+#endif
+    template<typename T> class BufferedWriter;
+    template<typename T> class RaggedArray;
+    template<typename T> class SparseMatrix;
+    template<typename T> struct CsrMatrix;
+    template<typename T> struct CooMatrix;
+    class Table;
+    class TableRows;
+    class StringView;
+    class StringArray;
+    template<typename T, std::size_t Alignment> class AlignedAllocator;
+    template<typename T> class TileQueue;
 
     enum class Intent { rdwr, rdonly, swmr_write, swmr_read };
     enum class Object { file, group, dataset };
+    enum class ThreadSafety { automatic, serialized, library };
+    enum class Transfer { independent, collective };
+    enum class LibraryVersion { earliest, v18, v110, latest };
+    enum class Order { name, creation };
+    enum class CloseDegree { automatic, weak, semi, strong };
+    struct LockStatistics;
+    struct ByteRun;
+    struct CacheStatistics;
+
+    template<typename T, std::size_t Alignment=4096>
+    using AlignedVector = std::vector<T, AlignedAllocator<T, Alignment>>;
+#ifdef H5_HAVE_PARALLEL
+    struct CollectiveBuffering;
+#endif
 
     namespace detail {
         class hyperslab;
+        class api_lock;
+        struct lock_state;
+        inline lock_state& get_lock_state();
+        inline unsigned& lock_depth();
         static inline herr_t get_last_error(unsigned, const H5E_error2_t*, void*);
         template<typename T> static inline T check(T);
         template<typename T> static inline Datatype make_datatype_for(const T&);
-        template<typename T> static inline Datatype make_datatype_for(const std::vector<T>&);
+        template<typename T, typename A> static inline Datatype make_datatype_for(const std::vector<T, A>&);
+        static inline Datatype make_datatype_for(const std::vector<std::string>&);
+        static inline Datatype make_datatype_for(const StringArray&);
+        static inline Dataspace make_dataspace_for(const StringArray&, bool selected_part=false);
         template<typename T> static inline Dataspace make_dataspace_for(const T&, bool selected_part=false);
-        template<typename T> static inline Dataspace make_dataspace_for(const std::vector<T>&, bool selected_part=false);
+        template<typename T, typename A> static inline Dataspace make_dataspace_for(const std::vector<T, A>&, bool selected_part=false);
         template<typename T> static inline void prepare(const Datatype&, const Dataspace&, T&);
-        template<typename T> static inline void prepare(const Datatype&, const Dataspace&, std::vector<T>&);
+        template<typename T, typename A> static inline void prepare(const Datatype&, const Dataspace&, std::vector<T, A>&);
         template<typename T> static inline void* get_address(T&);
-        template<typename T> static inline void* get_address(std::vector<T>&);
+        template<typename T, typename A> static inline void* get_address(std::vector<T, A>&);
         template<typename T> static inline const void* get_address(const T&);
-        template<typename T> static inline const void* get_address(const std::vector<T>&);
+        template<typename T, typename A> static inline const void* get_address(const std::vector<T, A>&);
 
         template<typename T, int R> static inline Datatype make_datatype_for(const nd::ndarray<T, R>&);
         template<typename T, int R> static inline Dataspace make_dataspace_for(const nd::ndarray<T, R>&, bool selected_part=false);
         template<typename T, int R> static inline void prepare(const Datatype&, const Dataspace&, nd::ndarray<T, R>&);
         template<typename T, int R> static inline void* get_address(nd::ndarray<T, R>&);
         template<typename T, int R> static inline const void* get_address(const nd::ndarray<T, R>&);
+        template<typename T> static inline void extend(Dataset&, std::size_t, const std::vector<T>&);
+        template<typename T> static inline std::vector<T> read_range(Dataset&, std::size_t, std::size_t, unsigned threads=1);
+#ifdef __linux__
+        static inline void pread_runs(const std::string&, std::vector<ByteRun>, char*, unsigned);
+#endif
+#ifdef NDH5_HAVE_IO_URING
+        class uring;
+        class uring_driver;
+#endif
+        class cache_driver;
     }
 
     template<typename T> static inline Datatype native_type();
+    inline IOThread& io_thread();
+    inline bool library_is_threadsafe();
+    inline void set_thread_safety(ThreadSafety);
+    inline ThreadSafety get_thread_safety();
+    inline LockStatistics lock_statistics();
+    inline void reset_lock_statistics();
+}
+
+
+
+
+// ============================================================================
+/**
+ * Thread safety
+ * -------------
+ * ndh5 objects must not be shared between threads without synchronization,
+ * but distinct objects may be used from different threads concurrently.
+ * Every HDF5 call made by ndh5 is guarded by an internal recursive mutex,
+ * which is engaged according to the thread safety mode:
+ *
+ * automatic : serialize only if the HDF5 library is not thread-safe (the
+ *             default)
+ * serialized: always serialize, so that lock_statistics() measures the cost
+ *             of serialization (a thread-safe HDF5 serializes internally)
+ * library   : never serialize; HDF5 calls from multiple threads are only
+ *             safe if the library is thread-safe
+ *
+ * The mode should be set before any threads are started.
+ */
+struct h5::LockStatistics
+{
+    std::size_t acquisitions = 0;
+    std::size_t contentions = 0;
+    std::chrono::duration<double> wait_time {0};
+    std::chrono::duration<double> max_wait {0};
+};
+
+struct h5::detail::lock_state
+{
+    std::recursive_mutex mutex;
+    std::atomic<ThreadSafety> mode {ThreadSafety::automatic};
+    bool library_threadsafe = library_is_threadsafe();
+    LockStatistics statistics;
+};
+
+class h5::detail::api_lock
+{
+public:
+
+    api_lock()
+    {
+        auto& state = get_lock_state();
+        auto mode = state.mode.load(std::memory_order_relaxed);
+
+        if (mode == ThreadSafety::serialized || (mode == ThreadSafety::automatic && ! state.library_threadsafe))
+        {
+            mutex = &state.mutex;
+
+            // Only the outermost lock on a thread counts as an acquisition;
+            // nested ones cannot contend.
+            if (lock_depth()++ > 0)
+            {
+                mutex->lock();
+            }
+            else if (mutex->try_lock())
+            {
+                ++state.statistics.acquisitions;
+            }
+            else
+            {
+                auto start = std::chrono::steady_clock::now();
+                mutex->lock();
+                auto wait = std::chrono::steady_clock::now() - start;
+                state.statistics.acquisitions += 1;
+                state.statistics.contentions += 1;
+                state.statistics.wait_time += wait;
+                state.statistics.max_wait = std::max(state.statistics.max_wait, std::chrono::duration<double>(wait));
+            }
+        }
+    }
+
+    api_lock(const api_lock&) = delete;
+
+    ~api_lock()
+    {
+        if (mutex)
+        {
+            --lock_depth();
+            mutex->unlock();
+        }
+    }
+
+private:
+    std::recursive_mutex* mutex = nullptr;
+};
+
+// Not static: every translation unit must share the same lock state.
+h5::detail::lock_state& h5::detail::get_lock_state()
+{
+    static lock_state state;
+    return state;
+}
+
+unsigned& h5::detail::lock_depth()
+{
+    thread_local unsigned depth = 0;
+    return depth;
+}
+
+bool h5::library_is_threadsafe()
+{
+#if H5_VERSION_GE(1, 10, 1)
+    hbool_t threadsafe = false;
+    H5is_library_threadsafe(&threadsafe);
+    return threadsafe;
+#elif defined(H5_HAVE_THREADSAFE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void h5::set_thread_safety(ThreadSafety mode)
+{
+    detail::get_lock_state().mode = mode;
+}
+
+h5::ThreadSafety h5::get_thread_safety()
+{
+    return detail::get_lock_state().mode;
+}
+
+h5::LockStatistics h5::lock_statistics()
+{
+    auto& state = detail::get_lock_state();
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
+    return state.statistics;
+}
+
+void h5::reset_lock_statistics()
+{
+    auto& state = detail::get_lock_state();
+    std::lock_guard<std::recursive_mutex> lock(state.mutex);
+    state.statistics = LockStatistics();
 }
 
 
@@ -65,6 +299,16 @@ struct h5::detail::hyperslab
         block = std::vector<hsize_t>(sel.rank, 1);
     }
 
+    static hyperslab full(const std::vector<std::size_t>& extent)
+    {
+        auto slab = hyperslab();
+        slab.start = std::vector<hsize_t>(extent.size(), 0);
+        slab.skips = std::vector<hsize_t>(extent.size(), 1);
+        slab.count = std::vector<hsize_t>(extent.begin(), extent.end());
+        slab.block = std::vector<hsize_t>(extent.size(), 1);
+        return slab;
+    }
+
     void check_valid(hsize_t rank) const
     {
         if (start.size() != rank ||
@@ -76,8 +320,26 @@ struct h5::detail::hyperslab
         }
     }
 
+    /**
+     * Whether every selected index lies within the given extent.
+     */
+    bool within(const std::vector<std::size_t>& extent) const
+    {
+        check_valid(extent.size());
+
+        for (std::size_t a = 0; a < extent.size(); ++a)
+        {
+            if (count[a] != 0 && start[a] + (count[a] - 1) * skips[a] + block[a] > extent[a])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
     void select(hid_t space_id)
     {
+        detail::api_lock lock;
         check_valid(detail::check(H5Sget_simple_extent_ndims(space_id)));
         detail::check(H5Sselect_hyperslab(space_id, H5S_SELECT_SET,
             start.data(),
@@ -106,6 +368,7 @@ T h5::detail::check(T result)
 {
     if (result < 0)
     {
+        detail::api_lock lock;
         H5E_error2_t err;
         hid_t eid = H5Eget_current_stack();
         H5Ewalk(eid, H5E_WALK_UPWARD, get_last_error, &err);
@@ -123,8 +386,8 @@ inline void* h5::detail::get_address<std::string>(std::string& val)
     return &val[0];
 }
 
-template<typename T>
-inline void* h5::detail::get_address(std::vector<T>& val)
+template<typename T, typename A>
+inline void* h5::detail::get_address(std::vector<T, A>& val)
 {
     return &val[0];
 }
@@ -147,8 +410,8 @@ inline const void* h5::detail::get_address<std::string>(const std::string& val)
     return &val[0];
 }
 
-template<typename T>
-inline const void* h5::detail::get_address(const std::vector<T>& val)
+template<typename T, typename A>
+inline const void* h5::detail::get_address(const std::vector<T, A>& val)
 {
     return &val[0];
 }
@@ -168,6 +431,222 @@ inline const void* h5::detail::get_address(const nd::ndarray<T, R>& val)
 
 
 
+// ============================================================================
+/**
+ * An allocator whose blocks start on a multiple of Alignment bytes, as
+ * required for buffers used with O_DIRECT. Data sets can be read into, and
+ * written from, an AlignedVector<T> like any other std::vector.
+ */
+template<typename T, std::size_t Alignment>
+class h5::AlignedAllocator
+{
+public:
+    static_assert(Alignment >= alignof(void*) && (Alignment & (Alignment - 1)) == 0, "alignment must be a power of two");
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t count)
+    {
+        auto raw = static_cast<char*>(::operator new(count * sizeof(T) + Alignment + sizeof(void*)));
+        auto address = reinterpret_cast<std::uintptr_t>(raw + sizeof(void*));
+        auto aligned = reinterpret_cast<char*>((address + Alignment - 1) & ~std::uintptr_t(Alignment - 1));
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* data, std::size_t) noexcept
+    {
+        ::operator delete(reinterpret_cast<void**>(data)[-1]);
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept
+    {
+        return false;
+    }
+};
+
+
+
+
+// ============================================================================
+/**
+ * A non-owning view of a sequence of characters, standing in for the C++17
+ * std::string_view.
+ */
+class h5::StringView final
+{
+public:
+
+    StringView() {}
+    StringView(const char* data, std::size_t size) : ptr(data), count(size) {}
+    StringView(const char* data) : ptr(data), count(std::strlen(data)) {}
+    StringView(const std::string& value) : ptr(value.data()), count(value.size()) {}
+
+    const char* data() const { return ptr; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + count; }
+    char operator[](std::size_t i) const { return ptr[i]; }
+    std::string str() const { return std::string(ptr, count); }
+    explicit operator std::string() const { return str(); }
+
+    friend bool operator==(StringView a, StringView b)
+    {
+        return a.count == b.count && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    friend bool operator!=(StringView a, StringView b)
+    {
+        return ! (a == b);
+    }
+
+private:
+    const char* ptr = "";
+    std::size_t count = 0;
+};
+
+
+
+
+// ============================================================================
+/**
+ * An array of strings stored in one contiguous arena of null-terminated
+ * characters, with an offset to the start of each. The array is written as
+ * variable-length strings, or as fixed-length strings if it has a width.
+ * Reading variable-length strings places them directly in the arena, so
+ * there is one allocation for the whole array rather than one per string.
+ */
+class h5::StringArray final
+{
+public:
+
+    class iterator
+    {
+    public:
+        using value_type = StringView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const StringView*;
+        using reference = StringView;
+        using iterator_category = std::forward_iterator_tag;
+        iterator(const StringArray* array, std::size_t idx) : array(array), idx(idx) {}
+        iterator& operator++() { ++idx; return *this; }
+        iterator operator++(int) { auto ret = *this; ++idx; return ret; }
+        bool operator==(iterator other) const { return idx == other.idx; }
+        bool operator!=(iterator other) const { return idx != other.idx; }
+        StringView operator*() const { return (*array)[idx]; }
+
+    private:
+        const StringArray* array;
+        std::size_t idx;
+    };
+
+    StringArray() {}
+
+    StringArray(const std::vector<std::string>& values, std::size_t width=0) : string_width(width)
+    {
+        auto total = std::size_t(0);
+
+        for (const auto& value : values)
+        {
+            total += value.size() + 1;
+        }
+        arena.reserve(total);
+        offsets.reserve(values.size() + 1);
+
+        for (const auto& value : values)
+        {
+            push_back(value);
+        }
+    }
+
+    void push_back(StringView value)
+    {
+        arena.insert(arena.end(), value.begin(), value.end());
+        arena.push_back('\0');
+        offsets.push_back(arena.size());
+    }
+
+    std::size_t size() const
+    {
+        return offsets.size() - 1;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    StringView operator[](std::size_t i) const
+    {
+        return StringView(arena.data() + offsets[i], offsets[i + 1] - offsets[i] - 1);
+    }
+
+    iterator begin() const
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(this, size());
+    }
+
+    /**
+     * The width of each string when stored as fixed-length strings, or zero
+     * for variable-length strings.
+     */
+    std::size_t width() const
+    {
+        return string_width;
+    }
+
+    StringArray& fixed_length(std::size_t width)
+    {
+        string_width = width;
+        return *this;
+    }
+
+    std::vector<std::string> to_vector() const
+    {
+        auto result = std::vector<std::string>();
+        result.reserve(size());
+
+        for (auto value : *this)
+        {
+            result.push_back(value.str());
+        }
+        return result;
+    }
+
+private:
+    // ========================================================================
+    friend class Dataset;
+    std::vector<char> arena;
+    std::vector<std::size_t> offsets = {0};
+    std::size_t string_width = 0;
+};
+
+
+
+
 // ============================================================================
 class h5::Datatype final
 {
@@ -176,6 +655,7 @@ public:
 
     Datatype(const Datatype& other)
     {
+        detail::api_lock lock;
         id = H5Tcopy(other.id);
     }
 
@@ -192,6 +672,7 @@ public:
 
     Datatype& operator=(const Datatype& other)
     {
+        detail::api_lock lock;
         close();
         id = H5Tcopy(other.id);
         return *this;
@@ -199,6 +680,7 @@ public:
 
     bool operator==(const Datatype& other) const
     {
+        detail::api_lock lock;
         return detail::check(H5Tequal(id, other.id));
     }
 
@@ -209,6 +691,7 @@ public:
 
     void close()
     {
+        detail::api_lock lock;
         if (id != -1)
         {
             H5Tclose(id);
@@ -217,11 +700,13 @@ public:
 
     std::size_t size() const
     {
+        detail::api_lock lock;
         return detail::check(H5Tget_size(id));
     }
 
     Datatype with_size(std::size_t size) const
     {
+        detail::api_lock lock;
         Datatype other = *this;
         H5Tset_size(other.id, size);
         return other;
@@ -230,7 +715,8 @@ public:
 private:
     // ========================================================================
     template<typename T> friend Datatype detail::make_datatype_for(const T&);
-    template<typename T> friend Datatype detail::make_datatype_for(const std::vector<T>&);
+    template<typename T, typename A> friend Datatype detail::make_datatype_for(const std::vector<T, A>&);
+    friend Datatype detail::make_datatype_for(const StringArray&);
     template<typename T, int R> friend Datatype detail::make_datatype_for(const nd::ndarray<T, R>&); // NEED?
     friend class Link;
     friend class Dataset;
@@ -246,29 +732,54 @@ private:
 template<>
 inline h5::Datatype h5::detail::make_datatype_for<std::string>(const std::string& val)
 {
+    detail::api_lock lock;
     return Datatype(H5Tcopy(H5T_C_S1)).with_size(val.size());
 }
 
 template<>
 inline h5::Datatype h5::detail::make_datatype_for<char>(const char&)
 {
+    detail::api_lock lock;
     return H5Tcopy(H5T_C_S1);
 }
 
 template<>
 inline h5::Datatype h5::detail::make_datatype_for<int>(const int&)
 {
+    detail::api_lock lock;
     return H5Tcopy(H5T_NATIVE_INT);
 }
 
 template<>
 inline h5::Datatype h5::detail::make_datatype_for<double>(const double&)
 {
+    detail::api_lock lock;
     return H5Tcopy(H5T_NATIVE_DOUBLE);
 }
 
-template<typename T>
-inline h5::Datatype h5::detail::make_datatype_for(const std::vector<T>&)
+template<>
+inline h5::Datatype h5::detail::make_datatype_for<float>(const float&)
+{
+    detail::api_lock lock;
+    return H5Tcopy(H5T_NATIVE_FLOAT);
+}
+
+template<>
+inline h5::Datatype h5::detail::make_datatype_for<std::int64_t>(const std::int64_t&)
+{
+    detail::api_lock lock;
+    return H5Tcopy(H5T_NATIVE_INT64);
+}
+
+template<>
+inline h5::Datatype h5::detail::make_datatype_for<std::uint64_t>(const std::uint64_t&)
+{
+    detail::api_lock lock;
+    return H5Tcopy(H5T_NATIVE_UINT64);
+}
+
+template<typename T, typename A>
+inline h5::Datatype h5::detail::make_datatype_for(const std::vector<T, A>&)
 {
     return make_datatype_for(T());
 }
@@ -279,6 +790,27 @@ inline h5::Datatype h5::detail::make_datatype_for(const nd::ndarray<T, R>&)
     return make_datatype_for(T());
 }
 
+h5::Datatype h5::detail::make_datatype_for(const std::vector<std::string>&)
+{
+    return make_datatype_for(StringArray());
+}
+
+h5::Datatype h5::detail::make_datatype_for(const StringArray& value)
+{
+    detail::api_lock lock;
+    auto type = Datatype(H5Tcopy(H5T_C_S1));
+
+    if (value.width() == 0)
+    {
+        detail::check(H5Tset_size(type.id, H5T_VARIABLE));
+    }
+    else
+    {
+        detail::check(H5Tset_size(type.id, value.width()));
+        detail::check(H5Tset_strpad(type.id, H5T_STR_NULLPAD));
+    }
+    return type;
+}
 
 
 
@@ -300,24 +832,53 @@ class h5::Dataspace
 public:
     static Dataspace scalar()
     {
+        detail::api_lock lock;
         return detail::check(H5Screate(H5S_SCALAR));
     }
 
     template<typename Container>
     static Dataspace simple(Container dims)
     {
+        detail::api_lock lock;
         auto hdims = std::vector<hsize_t>(dims.begin(), dims.end());
         return detail::check(H5Screate_simple(int(hdims.size()), &hdims[0], nullptr));
     }
 
+    /**
+     * A simple data space which may be resized up to max_dims; axes whose
+     * maximum is Dataspace::unlimited may grow without bound. Data sets
+     * with a resizable space must be created with chunks.
+     */
+    template<typename Container>
+    static Dataspace simple(Container dims, Container max_dims)
+    {
+        detail::api_lock lock;
+        auto hdims = std::vector<hsize_t>(dims.begin(), dims.end());
+        auto hmax = std::vector<hsize_t>();
+
+        for (auto m : max_dims)
+        {
+            hmax.push_back(std::size_t(m) == unlimited ? H5S_UNLIMITED : hsize_t(m));
+        }
+        if (hmax.size() != hdims.size())
+        {
+            throw std::invalid_argument("dims and max_dims have different ranks");
+        }
+        return detail::check(H5Screate_simple(int(hdims.size()), &hdims[0], &hmax[0]));
+    }
+
+    enum : std::size_t { unlimited = std::size_t(-1) };
+
     Dataspace()
     {
+        detail::api_lock lock;
         id = detail::check(H5Screate(H5S_NULL));
     }
 
     template<int Rank, int Axis>
     Dataspace(nd::selector<Rank, Axis> sel)
     {
+        detail::api_lock lock;
         auto dims = std::vector<hsize_t>(sel.count.begin(), sel.count.end());
         auto slab = detail::hyperslab(sel);
         id = detail::check(H5Screate_simple(int(dims.size()), &dims[0], nullptr));
@@ -326,6 +887,7 @@ public:
 
     Dataspace(const Dataspace& other)
     {
+        detail::api_lock lock;
         id = detail::check(H5Scopy(other.id));
     }
 
@@ -341,6 +903,7 @@ public:
 
     Dataspace& operator=(const Dataspace& other)
     {
+        detail::api_lock lock;
         close();
         id = detail::check(H5Scopy(other.id));
         return *this;
@@ -348,6 +911,7 @@ public:
 
     bool operator==(const Dataspace& other) const
     {
+        detail::api_lock lock;
         return detail::check(H5Sextent_equal(id, other.id));
     }
 
@@ -358,6 +922,7 @@ public:
 
     void close()
     {
+        detail::api_lock lock;
         if (id != -1)
         {
             detail::check(H5Sclose(id));
@@ -366,28 +931,47 @@ public:
 
     std::size_t rank() const
     {
+        detail::api_lock lock;
         return detail::check(H5Sget_simple_extent_ndims(id));
     }
 
     std::size_t size() const
     {
+        detail::api_lock lock;
         return detail::check(H5Sget_simple_extent_npoints(id));
     }
 
     std::vector<std::size_t> extent() const
     {
+        detail::api_lock lock;
         auto ext = std::vector<hsize_t>(rank());
         detail::check(H5Sget_simple_extent_dims(id, &ext[0], nullptr));
         return std::vector<std::size_t>(ext.begin(), ext.end());
     }
 
+    std::vector<std::size_t> max_extent() const
+    {
+        detail::api_lock lock;
+        auto ext = std::vector<hsize_t>(rank());
+        detail::check(H5Sget_simple_extent_dims(id, nullptr, &ext[0]));
+        auto result = std::vector<std::size_t>();
+
+        for (auto e : ext)
+        {
+            result.push_back(e == H5S_UNLIMITED ? unlimited : std::size_t(e));
+        }
+        return result;
+    }
+
     std::size_t selection_size() const
     {
+        detail::api_lock lock;
         return detail::check(H5Sget_select_npoints(id));
     }
 
     std::vector<std::size_t> selection_lower() const
     {
+        detail::api_lock lock;
         auto lower = std::vector<hsize_t>(rank());
         auto upper = std::vector<hsize_t>(rank());
         detail::check(H5Sget_select_bounds(id, &lower[0], &upper[0]));
@@ -396,6 +980,7 @@ public:
 
     std::vector<std::size_t> selection_upper() const
     {
+        detail::api_lock lock;
         auto lower = std::vector<hsize_t>(rank());
         auto upper = std::vector<hsize_t>(rank());
         detail::check(H5Sget_select_bounds(id, &lower[0], &upper[0]));
@@ -404,12 +989,14 @@ public:
 
     Dataspace& select_all()
     {
+        detail::api_lock lock;
         detail::check(H5Sselect_all(id));
         return *this;
     }
 
     Dataspace& select_none()
     {
+        detail::api_lock lock;
         detail::check(H5Sselect_none(id));
         return *this;
     }
@@ -418,6 +1005,14 @@ private:
     // ========================================================================
     friend class Link;
     friend class Dataset;
+    template<typename T> friend class BufferedWriter;
+    friend class RolloverWriter;
+    friend class Table;
+    template<typename T> friend void detail::extend(Dataset&, std::size_t, const std::vector<T>&);
+    template<typename T> friend std::vector<T> detail::read_range(Dataset&, std::size_t, std::size_t, unsigned);
+#ifdef __linux__
+    friend class ReaderPool;
+#endif
 
     Dataspace(hid_t id) : id(id) {}
     hid_t id = -1;
@@ -433,8 +1028,13 @@ h5::Dataspace h5::detail::make_dataspace_for(const T&, bool)
     return Dataspace::scalar();
 }
 
-template<typename T>
-h5::Dataspace h5::detail::make_dataspace_for(const std::vector<T>& val, bool)
+template<typename T, typename A>
+h5::Dataspace h5::detail::make_dataspace_for(const std::vector<T, A>& val, bool)
+{
+    return Dataspace{val.size()};
+}
+
+h5::Dataspace h5::detail::make_dataspace_for(const StringArray& val, bool)
 {
     return Dataspace{val.size()};
 }
@@ -464,8 +1064,8 @@ inline void h5::detail::prepare(const Datatype& type, const Dataspace&, std::str
     value.resize(type.size());
 }
 
-template<typename T>
-inline void h5::detail::prepare(const Datatype&, const Dataspace& space, std::vector<T>& value)
+template<typename T, typename A>
+inline void h5::detail::prepare(const Datatype&, const Dataspace& space, std::vector<T, A>& value)
 {
     value.resize(space.selection_size());
 }
@@ -496,870 +1096,7413 @@ inline void h5::detail::prepare(const Datatype&, const Dataspace& space, nd::nda
 
 
 // ============================================================================
-class h5::Link
+/**
+ * Owns an HDF5 property list. A default-constructed instance refers to
+ * H5P_DEFAULT and is not closed.
+ */
+class h5::PropertyList final
 {
-private:
-
-    Link() {}
+public:
 
-    Link(hid_t id) : id(id) {}
+    static PropertyList file_access()
+    {
+        return create(H5P_FILE_ACCESS);
+    }
 
-    Link(Link&& other)
+    static PropertyList file_create()
     {
-        id = other.id;
-        other.id = -1;
+        return create(H5P_FILE_CREATE);
     }
 
-    Link(const Link& other) = delete;
+    static PropertyList dataset_create()
+    {
+        return create(H5P_DATASET_CREATE);
+    }
 
-    Link& operator=(Link&& other)
+    static PropertyList group_create()
     {
-        id = other.id;
-        other.id = -1;
-        return *this;
+        return create(H5P_GROUP_CREATE);
     }
 
-    void close(Object object)
+    /**
+     * Link creation properties which create any missing groups along a
+     * multi-component path.
+     */
+    static PropertyList link_create()
     {
-        if (id != -1)
-        {
-            switch (object)
-            {
-                case Object::file   : H5Fclose(id); break;
-                case Object::group  : H5Gclose(id); break;
-                case Object::dataset: H5Dclose(id); break;
-            }
-            id = -1;
-        }
+        auto lcpl = create(H5P_LINK_CREATE);
+        detail::api_lock lock;
+        detail::check(H5Pset_create_intermediate_group(lcpl.id, 1));
+        return lcpl;
     }
 
-    std::size_t size() const
+    static PropertyList dataset_transfer()
     {
-        auto op = [] (auto, auto, auto, auto) { return 0; };
-        auto idx = hsize_t(0);
-        H5Literate(id, H5_INDEX_NAME, H5_ITER_INC, &idx, op, nullptr);
-        return idx;
+        return create(H5P_DATASET_XFER);
     }
 
-    bool contains(const std::string& name, Object object) const
+    /**
+     * Independent transfer is the HDF5 default. Collective transfer only
+     * has an effect on files opened with the MPI-IO driver, and is
+     * equivalent to independent in builds without parallel HDF5.
+     */
+    static PropertyList dataset_transfer(Transfer transfer)
     {
-        if (H5Lexists(id, name.data(), H5P_DEFAULT))
+#ifdef H5_HAVE_PARALLEL
+        if (transfer == Transfer::collective)
         {
-            H5O_info_t info;
-            H5Oget_info_by_name(id, name.data(), &info, H5P_DEFAULT);
-
-            switch (object)
-            {
-                case Object::file   : return false;
-                case Object::group  : return info.type == H5O_TYPE_GROUP;
-                case Object::dataset: return info.type == H5O_TYPE_DATASET;
-            }
+            auto dxpl = dataset_transfer();
+            detail::api_lock lock;
+            detail::check(H5Pset_dxpl_mpio(dxpl.id, H5FD_MPIO_COLLECTIVE));
+            return dxpl;
         }
-        return false;
+#else
+        (void) transfer;
+#endif
+        return PropertyList();
     }
 
-    Link open_group(const std::string& name)
+    PropertyList() {}
+
+    PropertyList(const PropertyList& other)
     {
-        return detail::check(H5Gopen(id, name.data(),
-            H5P_DEFAULT));
+        detail::api_lock lock;
+        id = other.id == H5P_DEFAULT ? H5P_DEFAULT : detail::check(H5Pcopy(other.id));
     }
 
-    Link create_group(const std::string& name)
+    PropertyList(PropertyList&& other)
     {
-        return detail::check(H5Gcreate(id, name.data(),
-            H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+        id = other.id;
+        other.id = H5P_DEFAULT;
     }
 
-    Link open_dataset(const std::string& name)
+    ~PropertyList()
     {
-        return detail::check(H5Dopen(id, name.data(),
-            H5P_DEFAULT));
+        close();
     }
 
-    Link create_dataset(const std::string& name,
-                        const Datatype& type,
-                        const Dataspace& space)
+    PropertyList& operator=(const PropertyList& other)
     {
-        return detail::check(H5Dcreate(
-            id,
-            name.data(),
-            type.id,
-            space.id,
-            H5P_DEFAULT,
-            H5P_DEFAULT,
-            H5P_DEFAULT));
+        return *this = PropertyList(other);
     }
 
+    PropertyList& operator=(PropertyList&& other)
+    {
+        close();
+        id = other.id;
+        other.id = H5P_DEFAULT;
+        return *this;
+    }
 
-
-
-    // ========================================================================
-    class iterator
+    void close()
     {
-    public:
-        using value_type = std::string;
-        using iterator_category = std::forward_iterator_tag;
-        iterator(hid_t id, hsize_t idx) : id(id), idx(idx) {}
-        iterator& operator++() { ++idx; return *this; }
-        iterator operator++(int) { auto ret = *this; this->operator++(); return ret; }
-        bool operator==(iterator other) const { return id == other.id && idx == other.idx; }
-        bool operator!=(iterator other) const { return id != other.id || idx != other.idx; }
-        std::string operator*() const
+        detail::api_lock lock;
+        if (id != H5P_DEFAULT)
         {
-            static char name[1024];
-
-            if (H5Lget_name_by_idx(id, ".",
-                H5_INDEX_NAME, H5_ITER_NATIVE, idx, name, 1024, H5P_DEFAULT) > 1024)
-            {
-                throw std::overflow_error("object names longer than 1024 are not supported");
-            }
-            return name;
+            H5Pclose(id);
+            id = H5P_DEFAULT;
         }
-
-    private:
-        hid_t id = -1;
-        hsize_t idx = 0;
-    };
-
-    iterator begin() const
-    {
-        return iterator(id, 0);
     }
 
-    iterator end() const
+private:
+    // ========================================================================
+    friend class Link;
+    friend class Dataset;
+    friend class File;
+    friend class FileOptions;
+    friend class DatasetOptions;
+    friend class GroupOptions;
+
+    static PropertyList create(hid_t cls)
     {
-        return iterator(id, size());
+        detail::api_lock lock;
+        return PropertyList(detail::check(H5Pcreate(cls)));
     }
 
+    PropertyList(hid_t id) : id(id) {}
+    hid_t id = H5P_DEFAULT;
+};
 
 
 
-    // ========================================================================
-    template <class GroupType, class DatasetType>
-    friend class Location;
-    friend class File;
-    friend class Group;
-    friend class Dataset;
 
-    hid_t id = -1;
+#ifdef H5_HAVE_PARALLEL
+// ============================================================================
+/**
+ * Collective buffering hints passed to MPI-IO (ROMIO) when opening a file.
+ * Zero values leave the MPI-IO defaults in place.
+ */
+struct h5::CollectiveBuffering
+{
+    std::string read = "automatic";
+    std::string write = "automatic";
+    int nodes = 0;
+    std::size_t buffer_size = 0;
 };
+#endif // H5_HAVE_PARALLEL
 
 
 
 
+#ifdef NDH5_HAVE_IO_URING
 // ============================================================================
-class h5::Dataset final
+/**
+ * A minimal io_uring instance, set up with raw system calls so that liburing
+ * is not required.
+ */
+class h5::detail::uring final
 {
 public:
 
-    Dataset() {}
-
-    Dataset(const Dataset&) = delete;
-
-    Dataset(Dataset&& other)
+    uring(unsigned entries)
     {
-        link = std::move(other.link);
-    }
+        auto params = io_uring_params();
+        std::memset(&params, 0, sizeof(params));
+        fd = int(syscall(__NR_io_uring_setup, entries, &params));
 
-    Dataset& operator=(Dataset&& other)
-    {
-        link = std::move(other.link);
-        return *this;
-    }
+        if (fd < 0)
+        {
+            return;
+        }
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqe_size = params.sq_entries * sizeof(io_uring_sqe);
+        single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
 
-    ~Dataset()
-    {
-        close();
-    }
+        if (single_mmap)
+        {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cq_ptr = single_mmap ? sq_ptr : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqe_ptr = mmap(nullptr, sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
 
-    void close()
-    {
-        link.close(Object::dataset);
+        if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqe_ptr == MAP_FAILED)
+        {
+            release();
+            return;
+        }
+        auto sq = static_cast<char*>(sq_ptr);
+        auto cq = static_cast<char*>(cq_ptr);
+        sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        sqes     = static_cast<io_uring_sqe*>(sqe_ptr);
     }
 
-    Dataspace get_space() const
-    {
-        return detail::check(H5Dget_space(link.id));
-    }
+    uring(const uring&) = delete;
 
-    Datatype get_type() const
+    ~uring()
     {
-        return detail::check(H5Dget_type(link.id));
+        release();
     }
 
-    template<typename T>
-    void write(const T& value)
+    bool ok() const
     {
-        write(value, get_space());
+        return fd >= 0;
     }
 
-    template<typename T, typename Selector>
-    T write(const T& value, Selector sel)
+    void push(std::uint8_t opcode, int file, const void* data, std::size_t length, std::uint64_t offset, std::uint64_t user_data)
     {
-        auto extent = get_space().extent();
-        auto fspace = Dataspace(nd::with_count(sel, extent.begin(), extent.end()));
-        return write(value, fspace);
+        auto tail = *sq_tail;
+        auto index = tail & *sq_mask;
+        auto& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<std::uint64_t>(data);
+        sqe.len = unsigned(length);
+        sqe.off = offset;
+        sqe.user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted;
     }
 
-    template<typename T>
-    void write(const T& value, const Dataspace& fspace)
+    bool enter(unsigned wait)
     {
-        auto data = detail::get_address(value);
-        auto type = detail::make_datatype_for(value);
-        auto mspace = detail::make_dataspace_for(value);
-        check_compatible(type);
-        detail::check(H5Dwrite(link.id, type.id, mspace.id, fspace.id, H5P_DEFAULT, data));
-    }
+        while (true)
+        {
+            auto flags = wait ? IORING_ENTER_GETEVENTS : 0u;
+            auto result = syscall(__NR_io_uring_enter, fd, unsubmitted, wait, flags, nullptr, 0);
 
-    template<typename T>
-    T read()
-    {
-        return read<T>(get_space());
+            if (result >= 0)
+            {
+                unsubmitted -= unsigned(result);
+                return true;
+            }
+            if (errno != EINTR)
+            {
+                return false;
+            }
+        }
     }
 
-    template<typename T, typename Selector>
-    T read(Selector sel)
+    bool pop(std::uint64_t& user_data, int& result)
     {
-        auto extent = get_space().extent();
-        auto fspace = Dataspace(nd::with_count(sel, extent.begin(), extent.end()));
-        return read<T>(fspace);
-    }
+        auto head = *cq_head;
 
-    template<typename T>
-    T read(const Dataspace& fspace)
-    {
-        T value;
-        detail::prepare(get_type(), fspace, value);
-        auto data = detail::get_address(value);
-        auto type = detail::make_datatype_for(value);
-        auto mspace = detail::make_dataspace_for(value);
-        check_compatible(type);
-        detail::check(H5Dread(link.id, type.id, mspace.id, fspace.id, H5P_DEFAULT, data));
-        return value;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        {
+            return false;
+        }
+        const auto& cqe = cqes[head & *cq_mask];
+        user_data = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
     }
 
 private:
     // ========================================================================
-    Datatype check_compatible(const Datatype& type) const
+    void release()
     {
-        if (type != get_type())
-        {
-            throw std::invalid_argument("source and target have different data types");
-        }
-        return type;
+        if (sqe_ptr && sqe_ptr != MAP_FAILED) munmap(sqe_ptr, sqe_size);
+        if (cq_ptr && cq_ptr != MAP_FAILED && ! single_mmap) munmap(cq_ptr, cq_size);
+        if (sq_ptr && sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+        if (fd >= 0) ::close(fd);
+        sq_ptr = cq_ptr = sqe_ptr = nullptr;
+        fd = -1;
     }
 
-    // ========================================================================
-    template <class GroupType, class DatasetType>
-    friend class Location;
-
-    Dataset(Link link) : link(std::move(link)) {}
-    Link link;
+    int fd = -1;
+    bool single_mmap = false;
+    unsigned unsubmitted = 0;
+    std::size_t sq_size = 0, cq_size = 0, sqe_size = 0;
+    void* sq_ptr = nullptr;
+    void* cq_ptr = nullptr;
+    void* sqe_ptr = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    io_uring_sqe* sqes = nullptr;
 };
 
 
 
 
 // ============================================================================
-template <class GroupType, class DatasetType>
-class h5::Location
+/**
+ * A virtual file driver for POSIX files which performs its I/O through
+ * io_uring. Writes are copied and submitted asynchronously, up to the queue
+ * depth, and are completed before any read, flush, truncate or close. Reads
+ * larger than the block size are split into blocks which are submitted
+ * together. If io_uring is unavailable, the driver uses pread and pwrite.
+ */
+class h5::detail::uring_driver final
 {
 public:
 
-    Location() {}
-
-    Location(const Group&) = delete;
-
-    Location(Location&& other)
+    struct config
     {
-        link = std::move(other.link);
-    }
+        unsigned queue_depth = 32;
+        std::size_t block_size = 1 << 20;
+    };
 
-    Location& operator=(Location&& other)
+    static hid_t id()
     {
-        link = std::move(other.link);
-        return *this;
-    }
+        static hid_t driver_id = -1;
+        static H5FD_class_t cls = make_class();
+        api_lock lock;
 
-    bool is_open() const
-    {
-        return link.id != -1;
+        if (driver_id < 0 || H5Iis_valid(driver_id) <= 0)
+        {
+            driver_id = check(H5FDregister(&cls));
+        }
+        return driver_id;
     }
 
-    std::size_t size() const
+private:
+    // ========================================================================
+    struct state
     {
-        return link.size();
-    }
+        int fd = -1;
+        haddr_t eoa = 0;
+        haddr_t eof = 0;
+        dev_t device = 0;
+        ino_t inode = 0;
+        config conf;
+        std::unique_ptr<uring> ring;
+        std::map<std::uint64_t, std::vector<char>> writes;
+        std::map<std::uint64_t, std::uint64_t> write_offsets;
+        std::uint64_t next_id = 0;
+        int error = 0;
+    };
 
-    Link::iterator begin() const
+    struct file_t
     {
-        return link.begin();
-    }
+        H5FD_t pub;
+        state* impl;
+    };
 
-    Link::iterator end() const
+    static state& get(const H5FD_t* file)
     {
-        return link.end();
+        return *reinterpret_cast<const file_t*>(file)->impl;
     }
 
-    GroupType operator[](const std::string& name)
+    static herr_t fail(const char* func, hid_t minor, const char* message)
     {
-        return require_group(name);
+        H5Epush2(H5E_DEFAULT, __FILE__, func, __LINE__, H5E_ERR_CLS, H5E_VFL, minor, "%s", message);
+        return -1;
     }
 
-    GroupType open_group(const std::string& name)
+    /**
+     * Report the first error from the writes completed since the last
+     * report, and clear it, so that one failed write fails one call.
+     */
+    static herr_t take_error(state& s, const char* func, hid_t minor)
     {
-        return link.open_group(name);
+        auto error = s.error;
+        s.error = 0;
+        return error ? fail(func, minor, std::strerror(error)) : 0;
     }
 
-    GroupType require_group(const std::string& name)
+    static bool write_fully(int fd, const char* data, std::size_t length, std::uint64_t offset)
     {
-        if (link.contains(name, Object::group))
+        while (length > 0)
         {
-            return open_group(name);
-        }
-        return link.create_group(name);
-    }
+            auto n = pwrite(fd, data, length, off_t(offset));
 
-    DatasetType open_dataset(const std::string& name)
-    {
-        return link.open_dataset(name);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data += n;
+            length -= std::size_t(n);
+            offset += std::uint64_t(n);
+        }
+        return true;
     }
 
-    DatasetType require_dataset(const std::string& name,
-                                const Datatype& type,
-                                const Dataspace& space)
+    static bool read_fully(int fd, char* data, std::size_t length, std::uint64_t offset)
     {
-        if (link.contains(name, Object::dataset))
+        while (length > 0)
         {
-            auto dset = open_dataset(name);
+            auto n = pread(fd, data, length, off_t(offset));
 
-            if (dset.get_type() == type &&
-                dset.get_space() == space)
+            if (n < 0 && errno == EINTR)
             {
-                return dset;
+                continue;
             }
-            throw std::invalid_argument(
-                "data set with different type or space already exists");
+            if (n < 0)
+            {
+                return false;
+            }
+            if (n == 0)
+            {
+                std::memset(data, 0, length);
+                return true;
+            }
+            data += n;
+            length -= std::size_t(n);
+            offset += std::uint64_t(n);
         }
-        return link.create_dataset(name, type, space);
+        return true;
     }
 
-    template<typename T>
-    DatasetType require_dataset(const std::string& name, const Dataspace& space={})
+    static void complete_write(state& s, std::uint64_t id, int result)
     {
-        return require_dataset(name, detail::make_datatype_for(T()), space);
-    }
+        auto& data = s.writes[id];
+        auto offset = s.write_offsets[id];
+        auto done = result < 0 ? std::size_t(0) : std::size_t(result);
 
-    template<typename T>
-    void write(const std::string& name, const T& value)
-    {
-        auto type = detail::make_datatype_for(value);
-        auto space = detail::make_dataspace_for(value, true);
-        require_dataset(name, type, space).write(value);
+        if (done < data.size() && ! write_fully(s.fd, data.data() + done, data.size() - done, offset + done) && s.error == 0)
+        {
+            s.error = errno ? errno : EIO;
+        }
+        s.writes.erase(id);
+        s.write_offsets.erase(id);
     }
 
-    template<typename T, typename Selector>
-    void write(const std::string& name, const T& value, Selector sel)
+    static bool reap(state& s, unsigned wait)
     {
-        auto type = detail::make_datatype_for(value);
-        auto space = detail::make_dataspace_for(value, true);
-        require_dataset(name, type, space).write(value, sel);
-    }
+        if (! s.ring->enter(wait))
+        {
+            s.error = s.error ? s.error : errno;
+            return false;
+        }
+        auto id = std::uint64_t(0);
+        auto result = 0;
 
-    template<typename T>
-    T read(const std::string& name)
-    {
-        return open_dataset(name).template read<T>();
+        while (s.ring->pop(id, result))
+        {
+            complete_write(s, id, result);
+        }
+        return true;
     }
 
-    template<typename T, typename Selector>
-    T read(const std::string& name, Selector sel)
+    static void drain(state& s)
     {
-        return open_dataset(name).template read<T>(sel);
+        // A failed write does not stop the others from being reaped, since
+        // the kernel may still be reading from their buffers. Only a ring
+        // which can no longer be entered leaves writes in flight.
+        while (! s.writes.empty() && reap(s, 1))
+        {
+        }
     }
 
-protected:
     // ========================================================================
-    Location(Link link) : link(std::move(link)) {}
-    Link link;
-};
+    static H5FD_t* open(const char* name, unsigned flags, hid_t fapl, haddr_t maxaddr)
+    {
+        auto o_flags = (flags & H5F_ACC_RDWR) ? O_RDWR : O_RDONLY;
 
+        if (flags & H5F_ACC_TRUNC) o_flags |= O_TRUNC;
+        if (flags & H5F_ACC_CREAT) o_flags |= O_CREAT;
+        if (flags & H5F_ACC_EXCL)  o_flags |= O_EXCL;
 
+        auto fd = ::open(name, o_flags | O_CLOEXEC, 0666);
+        struct stat sb;
 
+        if (fd < 0 || fstat(fd, &sb) != 0)
+        {
+            if (fd >= 0) ::close(fd);
+            fail(__func__, H5E_CANTOPENFILE, std::strerror(errno));
+            return nullptr;
+        }
+        auto impl = new state;
+        auto conf = static_cast<const config*>(H5Pget_driver_info(fapl));
+        impl->fd = fd;
+        impl->eof = haddr_t(sb.st_size);
+        impl->device = sb.st_dev;
+        impl->inode = sb.st_ino;
+        impl->conf = conf ? *conf : config();
+        impl->conf.queue_depth = std::max(impl->conf.queue_depth, 1u);
+        impl->conf.block_size = std::max(impl->conf.block_size, std::size_t(4096));
+        impl->ring.reset(new uring(impl->conf.queue_depth));
+
+        if (! impl->ring->ok())
+        {
+            impl->ring.reset();
+        }
+        auto file = new file_t();
+        file->impl = impl;
+        (void) maxaddr;
+        return &file->pub;
+    }
 
-// ============================================================================
-class h5::Group final : public Location<Group, Dataset>
-{
-public:
-    Group() {}
+    static herr_t close(H5FD_t* file)
+    {
+        auto f = reinterpret_cast<file_t*>(file);
+        auto& s = *f->impl;
 
-    Group(const Group&) = delete;
+        if (s.ring)
+        {
+            drain(s);
+        }
+        // The ring is released before the write buffers it may still refer
+        // to, and everything is torn down before any error is reported.
+        s.ring.reset();
 
-    Group(Group&& other)
+        auto error = s.error;
+
+        if (::close(s.fd) != 0 && error == 0)
+        {
+            error = errno ? errno : EIO;
+        }
+        delete f->impl;
+        delete f;
+
+        if (error != 0)
+        {
+            return fail(__func__, H5E_CANTCLOSEFILE, std::strerror(error));
+        }
+        return 0;
+    }
+
+    static int cmp(const H5FD_t* f1, const H5FD_t* f2)
     {
-        link = std::move(other.link);
+        const auto& a = get(f1);
+        const auto& b = get(f2);
+        if (a.device != b.device) return a.device < b.device ? -1 : 1;
+        if (a.inode != b.inode) return a.inode < b.inode ? -1 : 1;
+        return 0;
     }
 
-    ~Group()
+    static herr_t query(const H5FD_t*, unsigned long* flags)
     {
-        close();
+        *flags = H5FD_FEAT_AGGREGATE_METADATA
+        | H5FD_FEAT_ACCUMULATE_METADATA
+        | H5FD_FEAT_DATA_SIEVE
+        | H5FD_FEAT_AGGREGATE_SMALLDATA
+        | H5FD_FEAT_POSIX_COMPAT_HANDLE
+#ifdef H5FD_FEAT_DEFAULT_VFD_COMPATIBLE
+        | H5FD_FEAT_DEFAULT_VFD_COMPATIBLE
+#endif
+        ;
+        return 0;
     }
 
-    Group& operator=(Group&& other)
+    static haddr_t get_eoa(const H5FD_t* file, H5FD_mem_t)
     {
-        link = std::move(other.link);
-        return *this;
+        return get(file).eoa;
     }
 
-    void close()
+    static herr_t set_eoa(H5FD_t* file, H5FD_mem_t, haddr_t addr)
     {
-        link.close(Object::group);
+        get(file).eoa = addr;
+        return 0;
     }
 
-private:
-    template <class GroupType, class DatasetType> friend class h5::Location;
-    Group(Link link) : Location(std::move(link)) {}
-};
+    static haddr_t get_eof(const H5FD_t* file, H5FD_mem_t)
+    {
+        return get(file).eof;
+    }
+
+    static herr_t get_handle(H5FD_t* file, hid_t, void** handle)
+    {
+        *handle = &get(file).fd;
+        return 0;
+    }
+
+    static herr_t read(H5FD_t* file, H5FD_mem_t, hid_t, haddr_t addr, size_t size, void* buffer)
+    {
+        auto& s = get(file);
+        auto data = static_cast<char*>(buffer);
 
+        if (s.ring)
+        {
+            drain(s);
+        }
+        // Completions of writes still in flight would be mistaken for
+        // those of the blocks read below.
+        if (! s.writes.empty())
+        {
+            return fail(__func__, H5E_READERROR, "writes are still in flight");
+        }
+        if (addr >= s.eof)
+        {
+            std::memset(data, 0, size);
+            return 0;
+        }
+        if (addr + size > s.eof)
+        {
+            std::memset(data + (s.eof - addr), 0, addr + size - s.eof);
+            size = std::size_t(s.eof - addr);
+        }
+        if (! s.ring || size <= s.conf.block_size)
+        {
+            return read_fully(s.fd, data, size, addr) ? 0 : fail(__func__, H5E_READERROR, std::strerror(errno));
+        }
 
+        auto blocks = (size + s.conf.block_size - 1) / s.conf.block_size;
+        auto block_length = [&] (std::size_t b) { return std::min(s.conf.block_size, size - b * s.conf.block_size); };
+        auto submitted = std::size_t(0);
+        auto completed = std::size_t(0);
+        auto ok = true;
 
+        while (completed < blocks)
+        {
+            while (submitted < blocks && submitted - completed < s.conf.queue_depth)
+            {
+                auto offset = submitted * s.conf.block_size;
+                s.ring->push(IORING_OP_READ, s.fd, data + offset, block_length(submitted), addr + offset, submitted);
+                ++submitted;
+            }
+            if (! s.ring->enter(1))
+            {
+                return fail(__func__, H5E_READERROR, std::strerror(errno));
+            }
+            auto b = std::uint64_t(0);
+            auto result = 0;
 
-// ============================================================================
-class h5::File final : public Location<Group, Dataset>
-{
-public:
+            while (s.ring->pop(b, result))
+            {
+                auto offset = b * s.conf.block_size;
+                auto done = result < 0 ? std::size_t(0) : std::size_t(result);
+                auto length = block_length(b);
 
-    static bool exists(const std::string& filename)
+                if (done < length)
+                {
+                    ok = read_fully(s.fd, data + offset + done, length - done, addr + offset + done) && ok;
+                }
+                ++completed;
+            }
+        }
+        return ok ? 0 : fail(__func__, H5E_READERROR, std::strerror(errno));
+    }
+
+    static herr_t write(H5FD_t* file, H5FD_mem_t, hid_t, haddr_t addr, size_t size, const void* buffer)
     {
-        return H5Fis_hdf5(filename.data()) > 0;
+        auto& s = get(file);
+        auto data = static_cast<const char*>(buffer);
+
+        if (! s.ring)
+        {
+            if (! write_fully(s.fd, data, size, addr))
+            {
+                return fail(__func__, H5E_WRITEERROR, std::strerror(errno));
+            }
+        }
+        else
+        {
+            for (std::size_t offset = 0; offset < size; offset += s.conf.block_size)
+            {
+                auto length = std::min(s.conf.block_size, size - offset);
+
+                while (s.writes.size() >= s.conf.queue_depth)
+                {
+                    if (! reap(s, 1))
+                    {
+                        return take_error(s, __func__, H5E_WRITEERROR);
+                    }
+                }
+                auto id = s.next_id++;
+                auto& copy = s.writes[id];
+                copy.assign(data + offset, data + offset + length);
+                s.write_offsets[id] = addr + offset;
+                s.ring->push(IORING_OP_WRITE, s.fd, copy.data(), length, addr + offset, id);
+            }
+            if (! reap(s, 0))
+            {
+                return take_error(s, __func__, H5E_WRITEERROR);
+            }
+        }
+        s.eof = std::max(s.eof, haddr_t(addr + size));
+        return take_error(s, __func__, H5E_WRITEERROR);
     }
 
-    File() {}
+    static herr_t flush(H5FD_t* file, hid_t, hbool_t)
+    {
+        auto& s = get(file);
 
-    File(const std::string& filename, const std::string& mode="r")
+        if (s.ring)
+        {
+            drain(s);
+        }
+        if (! s.writes.empty())
+        {
+            return fail(__func__, H5E_WRITEERROR, "writes are still in flight");
+        }
+        return take_error(s, __func__, H5E_WRITEERROR);
+    }
+
+    static herr_t truncate(H5FD_t* file, hid_t, hbool_t)
     {
-        if (mode == "r")
+        auto& s = get(file);
+
+        if (s.ring)
         {
-            link.id = detail::check(H5Fopen(filename.data(), H5F_ACC_RDONLY, H5P_DEFAULT));
+            drain(s);
         }
-        else if (mode == "r+")
+        if (! s.writes.empty())
         {
-            link.id = detail::check(H5Fopen(filename.data(), H5F_ACC_RDWR, H5P_DEFAULT));
+            return fail(__func__, H5E_SEEKERROR, "writes are still in flight");
         }
-        else if (mode == "w")
+        if (s.eoa != s.eof)
         {
-            link.id = detail::check(H5Fcreate(filename.data(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT));
+            if (ftruncate(s.fd, off_t(s.eoa)) != 0)
+            {
+                return fail(__func__, H5E_SEEKERROR, std::strerror(errno));
+            }
+            s.eof = s.eoa;
         }
-        else
+        return 0;
+    }
+
+    static herr_t lock(H5FD_t* file, hbool_t rw)
+    {
+        if (flock(get(file).fd, (rw ? LOCK_EX : LOCK_SH) | LOCK_NB) != 0 && errno != ENOSYS)
         {
-            throw std::invalid_argument("File mode must be r, r+, or w");
+            return fail(__func__, H5E_CANTLOCKFILE, std::strerror(errno));
         }
+        return 0;
     }
 
-    File(const File&) = delete;
+    static herr_t unlock(H5FD_t* file)
+    {
+        if (flock(get(file).fd, LOCK_UN) != 0 && errno != ENOSYS)
+        {
+            return fail(__func__, H5E_CANTUNLOCKFILE, std::strerror(errno));
+        }
+        return 0;
+    }
 
-    File(File&& other)
+    static void* fapl_get(H5FD_t* file)
     {
-        link = std::move(other.link);
+        return new config(get(file).conf);
     }
 
-    ~File()
+    static void* fapl_copy(const void* conf)
     {
-        close();
+        return new config(*static_cast<const config*>(conf));
     }
 
-    File& operator=(File&& other)
+    static herr_t fapl_free(void* conf)
     {
-        link = std::move(other.link);
-        return *this;
+        delete static_cast<config*>(conf);
+        return 0;
     }
 
-    void close()
+    static H5FD_class_t make_class()
     {
-        link.close(Object::file);
+        auto cls = H5FD_class_t();
+#ifdef H5FD_CLASS_VERSION
+        cls.version = H5FD_CLASS_VERSION;
+        cls.value = H5FD_class_value_t(0x4e44);
+#endif
+        cls.name = "ndh5_io_uring";
+        cls.maxaddr = (haddr_t(1) << (8 * sizeof(off_t) - 1)) - 1;
+        cls.fc_degree = H5F_CLOSE_WEAK;
+        cls.fapl_size = sizeof(config);
+        cls.fapl_get = fapl_get;
+        cls.fapl_copy = fapl_copy;
+        cls.fapl_free = fapl_free;
+        cls.open = open;
+        cls.close = close;
+        cls.cmp = cmp;
+        cls.query = query;
+        cls.get_eoa = get_eoa;
+        cls.set_eoa = set_eoa;
+        cls.get_eof = get_eof;
+        cls.get_handle = get_handle;
+        cls.read = read;
+        cls.write = write;
+        cls.flush = flush;
+        cls.truncate = truncate;
+        cls.lock = lock;
+        cls.unlock = unlock;
+
+        for (int type = 0; type < H5FD_MEM_NTYPES; ++type)
+        {
+            cls.fl_map[type] = type == H5FD_MEM_DRAW || type == H5FD_MEM_LHEAP ? H5FD_MEM_DRAW : H5FD_MEM_SUPER;
+        }
+        return cls;
     }
+};
+#endif // NDH5_HAVE_IO_URING
 
-    Intent intent() const
+
+
+
+// ============================================================================
+/**
+ * Counters kept by the block cache driver for each open file. Hits and
+ * misses count blocks; read_ahead counts blocks fetched before they were
+ * requested; bytes_read counts bytes read from the underlying file.
+ */
+struct h5::CacheStatistics
+{
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t read_ahead = 0;
+    std::size_t bytes_requested = 0;
+    std::size_t bytes_read = 0;
+};
+
+
+
+
+// ============================================================================
+/**
+ * A virtual file driver which sits in front of sec2 and keeps an LRU cache of
+ * fixed-size blocks, limited to a byte budget. Misses on consecutive blocks
+ * are fetched with a single read, and when reads are found to be sequential,
+ * the next read_ahead blocks are fetched along with them. Writes go straight
+ * through to sec2 and update any cached blocks they overlap.
+ */
+class h5::detail::cache_driver final
+{
+public:
+
+    struct config
     {
-        unsigned intent;
-        detail::check(H5Fget_intent(link.id, &intent));
+        std::size_t cache_bytes = 64 << 20;
+        std::size_t block_size = 64 << 10;
+        unsigned read_ahead = 8;
+    };
+
+    struct counters
+    {
+        std::atomic<std::size_t> hits {0};
+        std::atomic<std::size_t> misses {0};
+        std::atomic<std::size_t> read_ahead {0};
+        std::atomic<std::size_t> bytes_requested {0};
+        std::atomic<std::size_t> bytes_read {0};
+    };
+
+    static hid_t id()
+    {
+        static hid_t driver_id = -1;
+        static H5FD_class_t cls = make_class();
+        api_lock lock;
+
+        if (driver_id < 0 || H5Iis_valid(driver_id) <= 0)
+        {
+            driver_id = check(H5FDregister(&cls));
+        }
+        return driver_id;
+    }
 
-        if (intent == H5F_ACC_RDWR)       return Intent::rdwr;
-        if (intent == H5F_ACC_RDONLY)     return Intent::rdonly;
-        // if (intent == H5F_ACC_SWMR_WRITE) return Intent::swmr_write;
-        // if (intent == H5F_ACC_SWMR_READ)  return Intent::swmr_read;
+    static CacheStatistics statistics(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        auto entry = registry().find(filename);
 
-        throw;
+        if (entry == registry().end())
+        {
+            throw std::invalid_argument("file was not opened with the block cache driver");
+        }
+        auto& c = *entry->second;
+        auto result = CacheStatistics();
+        result.hits = c.hits;
+        result.misses = c.misses;
+        result.read_ahead = c.read_ahead;
+        result.bytes_requested = c.bytes_requested;
+        result.bytes_read = c.bytes_read;
+        return result;
     }
 
 private:
     // ========================================================================
-    File(Link link) : Location(std::move(link)) {}
-};
+    struct block
+    {
+        std::vector<char> data;
+        std::list<std::uint64_t>::iterator position;
+    };
 
+    struct state
+    {
+        H5FD_t* inner = nullptr;
+        std::string name;
+        config conf;
+        std::list<std::uint64_t> lru;
+        std::unordered_map<std::uint64_t, block> blocks;
+        std::size_t bytes = 0;
+        haddr_t eoa = 0;
+        haddr_t last_end = HADDR_UNDEF;
+        unsigned streak = 0;
+        std::shared_ptr<counters> stats;
+    };
 
+    struct file_t
+    {
+        H5FD_t pub;
+        state* impl;
+    };
 
+    static state& get(const H5FD_t* file)
+    {
+        return *reinterpret_cast<const file_t*>(file)->impl;
+    }
 
-// ============================================================================
-#ifdef TEST_NDH5
-#include "catch.hpp"
-#include <array>
+    static std::map<std::string, std::shared_ptr<counters>>& registry()
+    {
+        static std::map<std::string, std::shared_ptr<counters>> files;
+        return files;
+    }
 
+    static std::mutex& registry_mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
 
+    static void touch(state& s, block& b)
+    {
+        s.lru.splice(s.lru.begin(), s.lru, b.position);
+    }
 
+    static block& insert(state& s, std::uint64_t index)
+    {
+        auto& b = s.blocks[index];
+        s.lru.push_front(index);
+        b.position = s.lru.begin();
+        return b;
+    }
 
-SCENARIO("Files can be created", "[h5::File]")
-{
-    GIVEN("A file opened for writing")
+    static void erase(state& s, std::unordered_map<std::uint64_t, block>::iterator entry)
     {
-        auto file = h5::File("test.h5", "w");
+        s.bytes -= entry->second.data.size();
+        s.lru.erase(entry->second.position);
+        s.blocks.erase(entry);
+    }
 
-        THEN("The file reports being opened with read/write intent")
+    static void evict(state& s)
+    {
+        while (s.bytes > s.conf.cache_bytes && ! s.lru.empty())
         {
-            REQUIRE(file.is_open());
-            REQUIRE(file.intent() == h5::Intent::rdwr);
+            erase(s, s.blocks.find(s.lru.back()));
         }
+    }
 
-        WHEN("The file is closed manually")
+    /**
+     * Return the cached block if it holds at least the given number of bytes.
+     */
+    static block* lookup(state& s, std::uint64_t index, std::size_t needed)
+    {
+        auto entry = s.blocks.find(index);
+        return entry != s.blocks.end() && entry->second.data.size() >= needed ? &entry->second : nullptr;
+    }
+
+    // ========================================================================
+    static H5FD_t* open(const char* name, unsigned flags, hid_t fapl, haddr_t maxaddr)
+    {
+        auto sec2 = H5Pcreate(H5P_FILE_ACCESS);
+
+        if (sec2 < 0 || H5Pset_fapl_sec2(sec2) < 0)
         {
-            file.close();
+            H5Pclose(sec2);
+            return nullptr;
+        }
+        auto inner = H5FDopen(name, flags, sec2, maxaddr);
+        H5Pclose(sec2);
 
-            THEN("It reports as not open, and can be closed again without effect")
-            {
-                REQUIRE_FALSE(file.is_open());
-                REQUIRE_NOTHROW(file.close());
-            }
+        if (! inner)
+        {
+            return nullptr;
+        }
+        auto impl = new state;
+        auto conf = static_cast<const config*>(H5Pget_driver_info(fapl));
+        impl->inner = inner;
+        impl->name = name;
+        impl->conf = conf ? *conf : config();
+        impl->conf.block_size = std::max(impl->conf.block_size, std::size_t(512));
+        impl->stats = std::make_shared<counters>();
+
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            registry()[impl->name] = impl->stats;
         }
+        auto file = new file_t();
+        file->impl = impl;
+        return &file->pub;
     }
 
-    GIVEN("A file is opened for reading")
+    static herr_t close(H5FD_t* file)
     {
-        auto file = h5::File("test.h5", "r");
-    
-        THEN("It reports as open with read-only intent")
+        auto f = reinterpret_cast<file_t*>(file);
+        auto result = H5FDclose(f->impl->inner);
+
         {
-            REQUIRE(file.is_open());
-            REQUIRE(file.intent() == h5::Intent::rdonly);
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            auto entry = registry().find(f->impl->name);
+
+            if (entry != registry().end() && entry->second == f->impl->stats)
+            {
+                registry().erase(entry);
+            }
         }
+        delete f->impl;
+        delete f;
+        return result;
     }
 
-    GIVEN("A filename that does not exist")
+    static int cmp(const H5FD_t* f1, const H5FD_t* f2)
     {
-        THEN("h5::File::exists reports it does not exist, and open as read throws")
+        return H5FDcmp(get(f1).inner, get(f2).inner);
+    }
+
+    static herr_t query(const H5FD_t* file, unsigned long* flags)
+    {
+        // The library queries the driver with no file before opening one.
+        if ((file ? H5FDquery(get(file).inner, flags) : H5FDdriver_query(H5FD_SEC2, flags)) < 0)
         {
-            REQUIRE_FALSE(h5::File::exists("no-exist.h5"));
-            REQUIRE_THROWS(h5::File("no-exist.h5", "r"));
+            return -1;
         }
+        // Direct access to the file descriptor would bypass the cache.
+        *flags &= ~static_cast<unsigned long>(H5FD_FEAT_POSIX_COMPAT_HANDLE);
+        return 0;
+    }
+
+    static haddr_t get_eoa(const H5FD_t* file, H5FD_mem_t)
+    {
+        return get(file).eoa;
     }
-}
 
+    static herr_t set_eoa(H5FD_t* file, H5FD_mem_t type, haddr_t addr)
+    {
+        auto& s = get(file);
+        s.eoa = addr;
+        return H5FDset_eoa(s.inner, type, addr);
+    }
 
-SCENARIO("Groups can be created in files", "[h5::Group]")
-{
-    GIVEN("A file opened for writing")
+    static haddr_t get_eof(const H5FD_t* file, H5FD_mem_t type)
     {
-        auto file = h5::File("test.h5", "w");
+        return H5FDget_eof(get(file).inner, type);
+    }
 
-        WHEN("Three groups are created")
+    static herr_t get_handle(H5FD_t* file, hid_t fapl, void** handle)
+    {
+        return H5FDget_vfd_handle(get(file).inner, fapl, handle);
+    }
+
+    static herr_t read(H5FD_t* file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, void* buffer)
+    {
+        auto& s = get(file);
+        auto data = static_cast<char*>(buffer);
+        auto bs = std::uint64_t(s.conf.block_size);
+
+        s.stats->bytes_requested += size;
+        s.streak = addr == s.last_end ? s.streak + 1 : 0;
+        s.last_end = addr + size;
+
+        if (size == 0)
         {
-            auto group1 = file.require_group("group1");
-            auto group2 = file.require_group("group2");
-            auto group3 = file.require_group("group3");
+            return 0;
+        }
+        auto end = addr + size;
+        auto first = addr / bs;
+        auto last = (end - 1) / bs;
+        auto needed = [&] (std::uint64_t b) { return std::size_t(std::min(end, (b + 1) * bs) - b * bs); };
+        auto copy_out = [&] (std::uint64_t b, const block& blk)
+        {
+            auto lo = std::max(addr, b * bs);
+            auto hi = std::min(end, (b + 1) * bs);
+            std::copy(blk.data.begin() + (lo - b * bs), blk.data.begin() + (hi - b * bs), data + (lo - addr));
+        };
 
-            THEN("file.size() returns 3")
+        for (auto b = first; b <= last;)
+        {
+            if (auto blk = lookup(s, b, needed(b)))
             {
-                REQUIRE(file.size() == 3);
+                ++s.stats->hits;
+                touch(s, *blk);
+                copy_out(b, *blk);
+                ++b;
+                continue;
             }
+            auto stop = b + 1;
 
-            THEN("The groups can be opened without throwing, but a non-existent group does throw")
+            while (stop <= last && ! lookup(s, stop, needed(stop)))
             {
-                REQUIRE_NOTHROW(file.open_group("group1"));
-                REQUIRE_NOTHROW(file.open_group("group2"));
-                REQUIRE_NOTHROW(file.open_group("group3"));
-                REQUIRE_THROWS(file.open_group("no-exist"));
-
-                REQUIRE_NOTHROW(file["group1"]);
-                REQUIRE_NOTHROW(file["group1"]["new-group"]); // creates a new group
+                ++stop;
             }
+            auto fetch = stop;
 
-            THEN("The groups have the correct names")
+            if (stop > last && s.streak >= 2)
+            {
+                while (fetch < stop + s.conf.read_ahead && fetch * bs < s.eoa && ! s.blocks.count(fetch))
+                {
+                    ++fetch;
+                }
+            }
+            auto lo = b * bs;
+            auto hi = std::min(fetch * bs, std::max(s.eoa, end));
+            auto staging = std::vector<char>(hi - lo);
+
+            if (H5FDread(s.inner, type, dxpl, lo, staging.size(), staging.data()) < 0)
+            {
+                return -1;
+            }
+            s.stats->bytes_read += staging.size();
+            s.stats->misses += stop - b;
+            s.stats->read_ahead += fetch - stop;
+
+            for (auto c = b; c < fetch && c * bs < hi; ++c)
+            {
+                auto entry = s.blocks.find(c);
+
+                if (entry != s.blocks.end())
+                {
+                    erase(s, entry);
+                }
+                auto& blk = insert(s, c);
+                auto first_byte = staging.begin() + (c * bs - lo);
+                auto last_byte = staging.begin() + (std::min((c + 1) * bs, hi) - lo);
+                blk.data.assign(first_byte, last_byte);
+                s.bytes += blk.data.size();
+
+                if (c < stop)
+                {
+                    copy_out(c, blk);
+                }
+            }
+            b = stop;
+        }
+        evict(s);
+        return 0;
+    }
+
+    static herr_t write(H5FD_t* file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, const void* buffer)
+    {
+        auto& s = get(file);
+        auto data = static_cast<const char*>(buffer);
+        auto bs = std::uint64_t(s.conf.block_size);
+
+        if (size == 0)
+        {
+            return 0;
+        }
+        if (H5FDwrite(s.inner, type, dxpl, addr, size, buffer) < 0)
+        {
+            return -1;
+        }
+        auto end = addr + size;
+
+        for (auto b = addr / bs; b <= (end - 1) / bs; ++b)
+        {
+            auto entry = s.blocks.find(b);
+
+            if (entry == s.blocks.end())
+            {
+                continue;
+            }
+            auto& blk = entry->second.data;
+            auto lo = std::max(addr, b * bs) - b * bs;
+            auto hi = std::min(end, (b + 1) * bs) - b * bs;
+
+            if (lo > blk.size())
+            {
+                erase(s, entry);
+                continue;
+            }
+            if (hi > blk.size())
+            {
+                s.bytes += hi - blk.size();
+                blk.resize(hi);
+            }
+            std::copy(data + (b * bs + lo - addr), data + (b * bs + hi - addr), blk.begin() + lo);
+        }
+        evict(s);
+        return 0;
+    }
+
+    static herr_t flush(H5FD_t* file, hid_t dxpl, hbool_t closing)
+    {
+        return H5FDflush(get(file).inner, dxpl, closing);
+    }
+
+    static herr_t truncate(H5FD_t* file, hid_t dxpl, hbool_t closing)
+    {
+        auto& s = get(file);
+        auto bs = std::uint64_t(s.conf.block_size);
+
+        for (auto entry = s.blocks.begin(); entry != s.blocks.end();)
+        {
+            auto current = entry++;
+
+            if (current->first * bs + current->second.data.size() > s.eoa)
+            {
+                erase(s, current);
+            }
+        }
+        return H5FDtruncate(s.inner, dxpl, closing);
+    }
+
+    static herr_t lock(H5FD_t* file, hbool_t rw)
+    {
+        return H5FDlock(get(file).inner, rw);
+    }
+
+    static herr_t unlock(H5FD_t* file)
+    {
+        return H5FDunlock(get(file).inner);
+    }
+
+    static void* fapl_get(H5FD_t* file)
+    {
+        return new config(get(file).conf);
+    }
+
+    static void* fapl_copy(const void* conf)
+    {
+        return new config(*static_cast<const config*>(conf));
+    }
+
+    static herr_t fapl_free(void* conf)
+    {
+        delete static_cast<config*>(conf);
+        return 0;
+    }
+
+    static H5FD_class_t make_class()
+    {
+        auto cls = H5FD_class_t();
+#ifdef H5FD_CLASS_VERSION
+        cls.version = H5FD_CLASS_VERSION;
+        cls.value = H5FD_class_value_t(0x4e45);
+#endif
+        cls.name = "ndh5_block_cache";
+        cls.maxaddr = (haddr_t(1) << (8 * sizeof(std::int64_t) - 1)) - 1;
+        cls.fc_degree = H5F_CLOSE_WEAK;
+        cls.fapl_size = sizeof(config);
+        cls.fapl_get = fapl_get;
+        cls.fapl_copy = fapl_copy;
+        cls.fapl_free = fapl_free;
+        cls.open = open;
+        cls.close = close;
+        cls.cmp = cmp;
+        cls.query = query;
+        cls.get_eoa = get_eoa;
+        cls.set_eoa = set_eoa;
+        cls.get_eof = get_eof;
+        cls.get_handle = get_handle;
+        cls.read = read;
+        cls.write = write;
+        cls.flush = flush;
+        cls.truncate = truncate;
+        cls.lock = lock;
+        cls.unlock = unlock;
+
+        for (int type = 0; type < H5FD_MEM_NTYPES; ++type)
+        {
+            cls.fl_map[type] = type == H5FD_MEM_DRAW || type == H5FD_MEM_LHEAP ? H5FD_MEM_DRAW : H5FD_MEM_SUPER;
+        }
+        return cls;
+    }
+};
+
+
+
+
+// ============================================================================
+/**
+ * Options used when a File is opened or created. SWMR (single-writer /
+ * multiple-reader) access requires the latest file format: a writer creates
+ * the file with latest_format(), creates its data sets, and then calls
+ * File::start_swmr_write(). Readers open the file in mode "r" with swmr(),
+ * and call Dataset::refresh() to see data appended by the writer.
+ */
+class h5::FileOptions final
+{
+public:
+
+    FileOptions() : fapl(PropertyList::file_access()), fcpl(PropertyList::file_create())
+    {
+    }
+
+    FileOptions& latest_format()
+    {
+        return library_versions(LibraryVersion::latest, LibraryVersion::latest);
+    }
+
+    /**
+     * Bound the versions of the file format used for objects that are
+     * written. A low bound of latest gives the fastest link and attribute
+     * storage, but the file can only be read by the newest libraries.
+     */
+    FileOptions& library_versions(LibraryVersion low, LibraryVersion high=LibraryVersion::latest)
+    {
+        auto version = [] (LibraryVersion v)
+        {
+            switch (v)
+            {
+                case LibraryVersion::earliest: return H5F_LIBVER_EARLIEST;
+#if H5_VERSION_GE(1, 10, 2)
+                case LibraryVersion::v18     : return H5F_LIBVER_V18;
+                case LibraryVersion::v110    : return H5F_LIBVER_V110;
+#else
+                case LibraryVersion::v18     : return H5F_LIBVER_LATEST;
+                case LibraryVersion::v110    : return H5F_LIBVER_LATEST;
+#endif
+                case LibraryVersion::latest  : return H5F_LIBVER_LATEST;
+            }
+            return H5F_LIBVER_LATEST;
+        };
+        detail::api_lock lock;
+        detail::check(H5Pset_libver_bounds(fapl.id, version(low), version(high)));
+        return *this;
+    }
+
+#if H5_VERSION_GE(1, 10, 7)
+    /**
+     * Turn file locking on or off, for example on read-only shared file
+     * systems which do not support it. When ignore_when_disabled is set,
+     * locking failures on such file systems are ignored rather than errors.
+     */
+    FileOptions& file_locking(bool enable, bool ignore_when_disabled=false)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_file_locking(fapl.id, enable, ignore_when_disabled));
+        return *this;
+    }
+#endif
+
+    /**
+     * Set what happens to objects that are still open when the file is
+     * closed: weak keeps the file open until they are closed, semi makes
+     * closing the file an error, and strong closes them as well.
+     */
+    FileOptions& close_degree(CloseDegree degree)
+    {
+        auto value = H5F_CLOSE_DEFAULT;
+
+        switch (degree)
+        {
+            case CloseDegree::automatic: value = H5F_CLOSE_DEFAULT; break;
+            case CloseDegree::weak     : value = H5F_CLOSE_WEAK; break;
+            case CloseDegree::semi     : value = H5F_CLOSE_SEMI; break;
+            case CloseDegree::strong   : value = H5F_CLOSE_STRONG; break;
+        }
+        detail::api_lock lock;
+        detail::check(H5Pset_fclose_degree(fapl.id, value));
+        return *this;
+    }
+
+    /**
+     * Size the metadata cache. If adaptive is false, the cache stays at its
+     * initial size instead of being resized according to its hit rate.
+     */
+    FileOptions& metadata_cache(std::size_t initial_size, std::size_t min_size, std::size_t max_size, bool adaptive=true)
+    {
+        detail::api_lock lock;
+        auto config = H5AC_cache_config_t();
+        config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+        detail::check(H5Pget_mdc_config(fapl.id, &config));
+        config.set_initial_size = true;
+        config.initial_size = initial_size;
+        config.min_size = min_size;
+        config.max_size = max_size;
+
+        if (! adaptive)
+        {
+            config.incr_mode = H5C_incr__off;
+            config.flash_incr_mode = H5C_flash_incr__off;
+            config.decr_mode = H5C_decr__off;
+        }
+        detail::check(H5Pset_mdc_config(fapl.id, &config));
+        return *this;
+    }
+
+    FileOptions& metadata_cache(H5AC_cache_config_t config)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_mdc_config(fapl.id, &config));
+        return *this;
+    }
+
+#if H5_VERSION_GE(1, 10, 1)
+    /**
+     * Write an image of the metadata cache into the file when it is closed,
+     * so that the next open loads the cache in a single read. The image is
+     * removed when the file is next opened for writing. Cache images need
+     * the 1.10 file format, so the low library version bound is raised to
+     * v110 if it is lower, as HDF5 would otherwise skip the image silently.
+     * Cache images cannot be used with SWMR or parallel access.
+     */
+    FileOptions& metadata_cache_image(bool enable=true, bool save_resize_status=false)
+    {
+        detail::api_lock lock;
+        auto config = H5AC_cache_image_config_t();
+        config.version = H5AC__CURR_CACHE_IMAGE_CONFIG_VERSION;
+        config.generate_image = enable;
+        config.save_resize_status = save_resize_status;
+        config.entry_ageout = H5AC__CACHE_IMAGE__ENTRY_AGEOUT__NONE;
+        detail::check(H5Pset_mdc_image_config(fapl.id, &config));
+
+#if H5_VERSION_GE(1, 10, 2)
+        auto low = H5F_LIBVER_EARLIEST;
+        auto high = H5F_LIBVER_LATEST;
+        detail::check(H5Pget_libver_bounds(fapl.id, &low, &high));
+
+        if (enable && low < H5F_LIBVER_V110)
+        {
+            detail::check(H5Pset_libver_bounds(fapl.id, H5F_LIBVER_V110, std::max(high, H5F_LIBVER_V110)));
+        }
+#else
+        if (enable)
+        {
+            detail::check(H5Pset_libver_bounds(fapl.id, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST));
+        }
+#endif
+        return *this;
+    }
+#endif
+
+    /**
+     * Set the sizes of the blocks in which small metadata objects, and
+     * small raw data objects, are aggregated before being written.
+     */
+    FileOptions& aggregation(std::size_t metadata_block_size, std::size_t small_data_block_size)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_meta_block_size(fapl.id, metadata_block_size));
+        detail::check(H5Pset_small_data_block_size(fapl.id, small_data_block_size));
+        return *this;
+    }
+
+    /**
+     * Set the size of the buffer used to combine small raw data reads and
+     * writes of contiguous data sets.
+     */
+    FileOptions& sieve_buffer(std::size_t size)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_sieve_buf_size(fapl.id, size));
+        return *this;
+    }
+
+    FileOptions& swmr(bool enable=true)
+    {
+        swmr_access = enable;
+        return *this;
+    }
+
+#ifdef NDH5_HAVE_IO_URING
+    /**
+     * Use a driver which performs I/O through Linux io_uring, keeping up to
+     * queue_depth requests of block_size bytes in flight.
+     */
+    FileOptions& io_uring_driver(unsigned queue_depth=32, std::size_t block_size=1 << 20)
+    {
+        auto conf = detail::uring_driver::config();
+        conf.queue_depth = queue_depth;
+        conf.block_size = block_size;
+        detail::api_lock lock;
+        detail::check(H5Pset_driver(fapl.id, detail::uring_driver::id(), &conf));
+        return *this;
+    }
+#endif
+
+    /**
+     * Place every file object of at least threshold bytes at an address that
+     * is a multiple of alignment.
+     */
+    FileOptions& alignment(std::size_t alignment, std::size_t threshold=1)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_alignment(fapl.id, threshold, alignment));
+        return *this;
+    }
+
+    /**
+     * Store datatype, dataspace, fill value and filter pipeline messages of
+     * at least min_size bytes once in a shared table, rather than in every
+     * object header that uses them. This shrinks files with many data sets
+     * of the same type and shape. It applies to files that are created.
+     */
+    FileOptions& shared_messages(unsigned min_size=8)
+    {
+        auto types = H5O_SHMESG_DTYPE_FLAG | H5O_SHMESG_SDSPACE_FLAG | H5O_SHMESG_FILL_FLAG | H5O_SHMESG_PLINE_FLAG;
+        detail::api_lock lock;
+        detail::check(H5Pset_shared_mesg_nindexes(fcpl.id, 1));
+        detail::check(H5Pset_shared_mesg_index(fcpl.id, 0, types, min_size));
+        return *this;
+    }
+
+    /**
+     * Use the split driver, which keeps metadata and raw data in two files
+     * named by appending meta_extension and raw_extension to the file name.
+     * Each half is accessed with the driver chosen in its own options, for
+     * example block_cache for the metadata and direct_io for the raw data.
+     */
+    FileOptions& split(
+        const std::string& meta_extension="-m.h5",
+        const std::string& raw_extension="-r.h5",
+        const FileOptions& meta=FileOptions(),
+        const FileOptions& raw=FileOptions())
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_fapl_split(fapl.id, meta_extension.data(), meta.fapl.id, raw_extension.data(), raw.fapl.id));
+        return *this;
+    }
+
+    /**
+     * Use the family driver, which stores the file as a sequence of members
+     * of member_size bytes each. The file name must contain a printf-style
+     * integer pattern such as "%d", which is replaced by the member number.
+     * When opening an existing family, a member_size of zero takes the size
+     * from the first member. Each member is accessed with the driver chosen
+     * in the member options.
+     */
+    FileOptions& family(std::size_t member_size=0, const FileOptions& member=FileOptions())
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_fapl_family(fapl.id, member_size, member.fapl.id));
+        return *this;
+    }
+
+#ifdef H5_HAVE_DIRECT
+    /**
+     * Use the O_DIRECT driver, which bypasses the page cache. Objects of at
+     * least one block are aligned, so that data set I/O can reach the disk
+     * without passing through the driver's copy buffer.
+     */
+    FileOptions& direct_io(std::size_t alignment=4096, std::size_t block_size=4096, std::size_t copy_buffer=16 << 20)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_fapl_direct(fapl.id, alignment, block_size, copy_buffer));
+        detail::check(H5Pset_alignment(fapl.id, block_size, alignment));
+        return *this;
+    }
+#endif
+
+    /**
+     * Use a driver which keeps an LRU cache of block_size blocks in front of
+     * sec2, limited to cache_bytes, and reads read_ahead blocks beyond
+     * sequential reads. Counters are available from File::cache_statistics.
+     */
+    FileOptions& block_cache(std::size_t cache_bytes=64 << 20, std::size_t block_size=64 << 10, unsigned read_ahead=8)
+    {
+        auto conf = detail::cache_driver::config();
+        conf.cache_bytes = cache_bytes;
+        conf.block_size = block_size;
+        conf.read_ahead = read_ahead;
+        detail::api_lock lock;
+        detail::check(H5Pset_driver(fapl.id, detail::cache_driver::id(), &conf));
+        return *this;
+    }
+
+private:
+    // ========================================================================
+    friend class File;
+    PropertyList fapl;
+    PropertyList fcpl;
+    bool swmr_access = false;
+};
+
+
+
+
+// ============================================================================
+/**
+ * Options used when a Dataset is created.
+ */
+class h5::DatasetOptions final
+{
+public:
+
+    DatasetOptions() : dcpl(PropertyList::dataset_create())
+    {
+    }
+
+    template<typename Container>
+    DatasetOptions& chunks(Container dims)
+    {
+        detail::api_lock lock;
+        auto hdims = std::vector<hsize_t>(dims.begin(), dims.end());
+        detail::check(H5Pset_chunk(dcpl.id, int(hdims.size()), &hdims[0]));
+        return *this;
+    }
+
+    DatasetOptions& chunks(std::initializer_list<std::size_t> dims)
+    {
+        return chunks(std::vector<std::size_t>(dims));
+    }
+
+    /**
+     * Record access, modification, change and birth times in the object
+     * header, which HDF5 does by default.
+     */
+    DatasetOptions& track_times(bool enable)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_obj_track_times(dcpl.id, enable));
+        return *this;
+    }
+
+#if H5_VERSION_GE(1, 10, 5)
+    /**
+     * Create the smallest object header, without space reserved for
+     * attributes, for data sets which will not have any.
+     */
+    DatasetOptions& minimize_header(bool enable=true)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_dset_no_attrs_hint(dcpl.id, enable));
+        return *this;
+    }
+#endif
+
+private:
+    // ========================================================================
+    template <class GroupType, class DatasetType>
+    friend class Location;
+    friend class Schema;
+    PropertyList dcpl;
+};
+
+
+
+
+// ============================================================================
+/**
+ * Options used when a Group is created. Groups store their links compactly
+ * in the object header until they exceed max_compact links, and then in a
+ * B-tree indexed by name, returning to compact storage below min_dense.
+ */
+class h5::GroupOptions final
+{
+public:
+
+    GroupOptions() : gcpl(PropertyList::group_create())
+    {
+    }
+
+    GroupOptions& link_phase_change(unsigned max_compact, unsigned min_dense)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_link_phase_change(gcpl.id, max_compact, min_dense));
+        return *this;
+    }
+
+    /**
+     * Size the group's initial storage for the expected number of links and
+     * their average name length.
+     */
+    GroupOptions& estimated_links(unsigned entries, unsigned name_length)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_est_link_info(gcpl.id, entries, name_length));
+        return *this;
+    }
+
+    /**
+     * Record access, modification, change and birth times in the group's
+     * object header, which HDF5 does by default.
+     */
+    GroupOptions& track_times(bool enable)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_obj_track_times(gcpl.id, enable));
+        return *this;
+    }
+
+    /**
+     * Record the order in which links are created. If indexed, a second
+     * B-tree is kept so that links can be listed in creation order from
+     * dense storage, which is otherwise only possible for compact groups.
+     */
+    GroupOptions& track_creation_order(bool indexed=true)
+    {
+        detail::api_lock lock;
+        detail::check(H5Pset_link_creation_order(gcpl.id, H5P_CRT_ORDER_TRACKED | (indexed ? H5P_CRT_ORDER_INDEXED : 0)));
+        return *this;
+    }
+
+private:
+    // ========================================================================
+    template <class GroupType, class DatasetType>
+    friend class Location;
+    friend class Schema;
+    PropertyList gcpl;
+};
+
+
+
+
+// ============================================================================
+/**
+ * A tree of groups and data sets to be created together by
+ * Location::require_schema. Paths may have several components, and
+ * missing intermediate groups are created with default options.
+ */
+class h5::Schema final
+{
+public:
+
+    Schema& group(const std::string& path, const GroupOptions& options=GroupOptions())
+    {
+        entries.push_back({path, Object::group, Datatype(), Dataspace(), options.gcpl});
+        return *this;
+    }
+
+    Schema& dataset(const std::string& path, const Datatype& type, const Dataspace& space, const DatasetOptions& options=DatasetOptions())
+    {
+        entries.push_back({path, Object::dataset, type, space, options.dcpl});
+        return *this;
+    }
+
+    template<typename T>
+    Schema& dataset(const std::string& path, const Dataspace& space, const DatasetOptions& options=DatasetOptions())
+    {
+        return dataset(path, detail::make_datatype_for(T()), space, options);
+    }
+
+    std::size_t size() const
+    {
+        return entries.size();
+    }
+
+private:
+    // ========================================================================
+    template <class GroupType, class DatasetType>
+    friend class Location;
+
+    struct Entry
+    {
+        std::string path;
+        Object object;
+        Datatype type;
+        Dataspace space;
+        PropertyList cpl;
+    };
+    std::vector<Entry> entries;
+};
+
+
+
+
+// ============================================================================
+class h5::Link
+{
+private:
+
+    Link() {}
+
+    Link(hid_t id) : id(id) {}
+
+    Link(Link&& other)
+    {
+        id = other.id;
+        other.id = -1;
+    }
+
+    Link(const Link& other) = delete;
+
+    Link& operator=(Link&& other)
+    {
+        id = other.id;
+        other.id = -1;
+        return *this;
+    }
+
+    void close(Object object)
+    {
+        detail::api_lock lock;
+        if (id != -1)
+        {
+            switch (object)
+            {
+                case Object::file   : H5Fclose(id); break;
+                case Object::group  : H5Gclose(id); break;
+                case Object::dataset: H5Dclose(id); break;
+            }
+            id = -1;
+        }
+    }
+
+    std::size_t size() const
+    {
+        detail::api_lock lock;
+        H5G_info_t info;
+        detail::check(H5Gget_info(id, &info));
+        return info.nlinks;
+    }
+
+    std::vector<std::string> names(H5_index_t index) const
+    {
+        detail::api_lock lock;
+        auto result = std::vector<std::string>();
+        auto op = [] (hid_t, const char* name, const H5L_info_t*, void* data)
+        {
+            static_cast<std::vector<std::string>*>(data)->emplace_back(name);
+            return herr_t(0);
+        };
+        auto idx = hsize_t(0);
+        result.reserve(size());
+        detail::check(H5Literate(id, index, H5_ITER_INC, &idx, op, &result));
+        return result;
+    }
+
+    bool contains(const std::string& name, Object object) const
+    {
+        detail::api_lock lock;
+
+        // H5Lexists fails unless every component but the last exists, and
+        // is a group, so walk the components once, opening each group and
+        // looking up the next component relative to it.
+        auto group = Link();
+        auto begin = std::size_t(0);
+
+        for (auto end = name.find('/', 1); end != std::string::npos; end = name.find('/', begin))
+        {
+            const auto& parent = group.id == -1 ? *this : group;
+            auto component = name.substr(begin, end - begin);
+            auto next = parent.exists_here(component, Object::group)
+                ? H5Gopen(parent.id, component.data(), H5P_DEFAULT)
+                : hid_t(-1);
+
+            group.close(Object::group);
+
+            if (next < 0)
+            {
+                return false;
+            }
+            group.id = next;
+            begin = end + 1;
+        }
+        const auto& parent = group.id == -1 ? *this : group;
+        auto result = parent.exists_here(name.substr(begin), object);
+        group.close(Object::group);
+        return result;
+    }
+
+    /**
+     * Like contains, for a path whose leading components are known to be
+     * groups.
+     */
+    bool exists_here(const std::string& name, Object object) const
+    {
+        detail::api_lock lock;
+        H5O_info_t info;
+
+        if (H5Lexists(id, name.data(), H5P_DEFAULT) > 0 &&
+            H5Oget_info_by_name(id, name.data(), &info, H5P_DEFAULT) >= 0)
+        {
+            switch (object)
+            {
+                case Object::file   : return false;
+                case Object::group  : return info.type == H5O_TYPE_GROUP;
+                case Object::dataset: return info.type == H5O_TYPE_DATASET;
+            }
+        }
+        return false;
+    }
+
+    Link open_group(const std::string& name)
+    {
+        detail::api_lock lock;
+        return detail::check(H5Gopen(id, name.data(),
+            H5P_DEFAULT));
+    }
+
+    Link create_group(const std::string& name, const PropertyList& gcpl=PropertyList())
+    {
+        auto lcpl = PropertyList::link_create();
+        detail::api_lock lock;
+        return detail::check(H5Gcreate(id, name.data(),
+            lcpl.id, gcpl.id, H5P_DEFAULT));
+    }
+
+    Link open_dataset(const std::string& name)
+    {
+        detail::api_lock lock;
+        return detail::check(H5Dopen(id, name.data(),
+            H5P_DEFAULT));
+    }
+
+    Link create_dataset(const std::string& name,
+                        const Datatype& type,
+                        const Dataspace& space,
+                        const PropertyList& dcpl=PropertyList())
+    {
+        auto lcpl = PropertyList::link_create();
+        detail::api_lock lock;
+        return detail::check(H5Dcreate(
+            id,
+            name.data(),
+            type.id,
+            space.id,
+            lcpl.id,
+            dcpl.id,
+            H5P_DEFAULT));
+    }
+
+    void create_external_link(const std::string& name, const std::string& filename, const std::string& path)
+    {
+        detail::api_lock lock;
+        detail::check(H5Lcreate_external(filename.data(), path.data(), id, name.data(), H5P_DEFAULT, H5P_DEFAULT));
+    }
+
+
+
+
+    // ========================================================================
+    class iterator
+    {
+    public:
+        using value_type = std::string;
+        using iterator_category = std::forward_iterator_tag;
+        iterator(hid_t id, hsize_t idx) : id(id), idx(idx) {}
+        iterator& operator++() { ++idx; return *this; }
+        iterator operator++(int) { auto ret = *this; this->operator++(); return ret; }
+        bool operator==(iterator other) const { return id == other.id && idx == other.idx; }
+        bool operator!=(iterator other) const { return id != other.id || idx != other.idx; }
+        std::string operator*() const
+        {
+            detail::api_lock lock;
+            auto size = detail::check(H5Lget_name_by_idx(id, ".",
+                H5_INDEX_NAME, H5_ITER_NATIVE, idx, nullptr, 0, H5P_DEFAULT));
+            auto name = std::string(size, '\0');
+            detail::check(H5Lget_name_by_idx(id, ".",
+                H5_INDEX_NAME, H5_ITER_NATIVE, idx, &name[0], size + 1, H5P_DEFAULT));
+            return name;
+        }
+
+    private:
+        hid_t id = -1;
+        hsize_t idx = 0;
+    };
+
+    iterator begin() const
+    {
+        return iterator(id, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(id, size());
+    }
+
+
+
+
+    // ========================================================================
+    template <class GroupType, class DatasetType>
+    friend class Location;
+    friend class File;
+    friend class Group;
+    friend class Dataset;
+    friend class Checkpoint;
+
+    hid_t id = -1;
+};
+
+
+
+
+// ============================================================================
+/**
+ * A contiguous run of bytes in a file, and where it lands in a dense,
+ * C-ordered memory buffer holding a selection.
+ */
+struct h5::ByteRun
+{
+    std::uint64_t file_offset = 0;
+    std::size_t memory_offset = 0;
+    std::size_t length = 0;
+};
+
+#ifdef __linux__
+/**
+ * Reads the runs from the named file into data, using the given number of
+ * threads, each issuing preadv calls for batches of runs that are adjacent
+ * in the file. HDF5 is not involved, so the reads are not serialized.
+ */
+void h5::detail::pread_runs(const std::string& filename, std::vector<ByteRun> runs, char* data, unsigned threads)
+{
+    const std::size_t piece = 1 << 22;
+    auto pieces = std::vector<ByteRun>();
+    auto total = std::size_t(0);
+
+    for (const auto& run : runs)
+    {
+        for (std::size_t done = 0; done < run.length; done += piece)
+        {
+            auto length = std::min(piece, run.length - done);
+            pieces.push_back({run.file_offset + done, run.memory_offset + done, length});
+        }
+        total += run.length;
+    }
+
+    auto fd = ::open(filename.data(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+    {
+        throw std::runtime_error(filename + ": " + std::strerror(errno));
+    }
+
+    std::atomic<int> error {0};
+    auto read_exactly = [&] (char* ptr, std::size_t length, std::uint64_t offset)
+    {
+        while (length > 0)
+        {
+            auto n = pread(fd, ptr, length, off_t(offset));
+
+            if (n <= 0)
+            {
+                error = n == 0 ? EIO : errno;
+                return;
+            }
+            ptr += n;
+            length -= std::size_t(n);
+            offset += std::uint64_t(n);
+        }
+    };
+    auto read_range = [&] (std::size_t begin, std::size_t end)
+    {
+        auto iov = std::vector<iovec>();
+
+        while (begin < end && error == 0)
+        {
+            auto batch = begin + 1;
+            auto expected = pieces[begin].length;
+
+            while (batch < end && batch - begin < IOV_MAX &&
+                pieces[batch].file_offset == pieces[batch - 1].file_offset + pieces[batch - 1].length)
+            {
+                expected += pieces[batch].length;
+                ++batch;
+            }
+            iov.clear();
+
+            for (auto i = begin; i < batch; ++i)
+            {
+                iov.push_back({data + pieces[i].memory_offset, pieces[i].length});
+            }
+            if (preadv(fd, iov.data(), int(iov.size()), off_t(pieces[begin].file_offset)) != ssize_t(expected))
+            {
+                for (auto i = begin; i < batch; ++i)
+                {
+                    read_exactly(data + pieces[i].memory_offset, pieces[i].length, pieces[i].file_offset);
+                }
+            }
+            begin = batch;
+        }
+    };
+
+    auto workers = std::vector<std::thread>();
+    auto share = total / std::max(threads, 1u) + 1;
+    auto begin = std::size_t(0);
+    auto bytes = std::size_t(0);
+
+    for (std::size_t i = 0; i < pieces.size(); ++i)
+    {
+        bytes += pieces[i].length;
+
+        if (bytes >= share || i + 1 == pieces.size())
+        {
+            workers.emplace_back(read_range, begin, i + 1);
+            begin = i + 1;
+            bytes = 0;
+        }
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    ::close(fd);
+
+    if (error != 0)
+    {
+        throw std::runtime_error(filename + ": " + std::strerror(error));
+    }
+}
+#endif // __linux__
+
+
+
+
+// ============================================================================
+/**
+ * A dedicated thread that runs HDF5 work submitted through the *_async
+ * methods of Dataset and Location, in submission order. Buffers given to
+ * those methods are either moved in, or passed as std::cref and pinned by
+ * the caller until the returned future is ready.
+ *
+ * Only work submitted here runs on the I/O thread. Synchronous calls such
+ * as read and write run on the calling thread, and are serialized with the
+ * I/O thread (and with each other) only by api_lock. Asynchronous work is
+ * therefore ordered with respect to other asynchronous work, but not with
+ * respect to synchronous calls made before its future is ready.
+ */
+class h5::IOThread final
+{
+public:
+
+    IOThread() : thread([this] { run(); })
+    {
+    }
+
+    IOThread(const IOThread&) = delete;
+
+    ~IOThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_one();
+        thread.join();
+    }
+
+    template<typename Function>
+    auto submit(Function&& function) -> std::future<decltype(function())>
+    {
+        using R = decltype(function());
+        auto work = std::make_shared<std::function<R()>>(std::forward<Function>(function));
+        auto promise = std::make_shared<std::promise<R>>();
+        auto future = promise->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back([work, promise]
+            {
+                try {
+                    fulfill(*work, *promise);
+                }
+                catch (...)
+                {
+                    *work = nullptr;
+                    promise->set_exception(std::current_exception());
+                }
+            });
+        }
+        condition.notify_one();
+        return future;
+    }
+
+    void wait()
+    {
+        submit([] {}).wait();
+    }
+
+private:
+    // ========================================================================
+    // The work is released before the promise is fulfilled, so that HDF5
+    // handles it holds are closed by the time the caller's future is ready.
+    template<typename R>
+    static void fulfill(std::function<R()>& work, std::promise<R>& promise)
+    {
+        auto result = work();
+        work = nullptr;
+        promise.set_value(std::move(result));
+    }
+
+    static void fulfill(std::function<void()>& work, std::promise<void>& promise)
+    {
+        work();
+        work = nullptr;
+        promise.set_value();
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || ! tasks.empty(); });
+
+                if (tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    std::thread thread;
+};
+
+
+
+
+// ============================================================================
+// Not static: every translation unit must share the same I/O thread.
+h5::IOThread& h5::io_thread()
+{
+    static IOThread thread;
+    return thread;
+}
+
+
+
+
+// ============================================================================
+class h5::Dataset final
+{
+public:
+
+    Dataset() {}
+
+    Dataset(const Dataset&) = delete;
+
+    Dataset(Dataset&& other)
+    {
+        link = std::move(other.link);
+    }
+
+    Dataset& operator=(Dataset&& other)
+    {
+        link = std::move(other.link);
+        return *this;
+    }
+
+    ~Dataset()
+    {
+        close();
+    }
+
+    void close()
+    {
+        link.close(Object::dataset);
+    }
+
+    Dataspace get_space() const
+    {
+        detail::api_lock lock;
+        return detail::check(H5Dget_space(link.id));
+    }
+
+    Datatype get_type() const
+    {
+        detail::api_lock lock;
+        return detail::check(H5Dget_type(link.id));
+    }
+
+    template<typename Container>
+    void resize(Container dims)
+    {
+        detail::api_lock lock;
+        auto hdims = std::vector<hsize_t>(dims.begin(), dims.end());
+        detail::check(H5Dset_extent(link.id, &hdims[0]));
+    }
+
+    void resize(std::initializer_list<std::size_t> dims)
+    {
+        resize(std::vector<std::size_t>(dims));
+    }
+
+    void flush()
+    {
+        detail::api_lock lock;
+        detail::check(H5Dflush(link.id));
+    }
+
+    void refresh()
+    {
+        detail::api_lock lock;
+        detail::check(H5Drefresh(link.id));
+    }
+
+    template<typename T>
+    void write(const T& value)
+    {
+        write(value, get_space());
+    }
+
+    template<typename T, typename Selector>
+    void write(const T& value, Selector sel, Transfer transfer=Transfer::independent)
+    {
+        auto extent = get_space().extent();
+        auto fspace = Dataspace(nd::with_count(sel, extent.begin(), extent.end()));
+        return write(value, fspace, transfer);
+    }
+
+    template<typename T>
+    void write(const T& value, const Dataspace& fspace, Transfer transfer=Transfer::independent)
+    {
+        detail::api_lock lock;
+        auto data = detail::get_address(value);
+        auto type = detail::make_datatype_for(value);
+        auto mspace = detail::make_dataspace_for(value);
+        auto dxpl = PropertyList::dataset_transfer(transfer);
+        check_compatible(type);
+        detail::check(H5Dwrite(link.id, type.id, mspace.id, fspace.id, dxpl.id, data));
+    }
+
+    template<typename T>
+    T read()
+    {
+        return read<T>(get_space());
+    }
+
+    template<typename T, typename Selector>
+    T read(Selector sel, Transfer transfer=Transfer::independent)
+    {
+        auto extent = get_space().extent();
+        auto fspace = Dataspace(nd::with_count(sel, extent.begin(), extent.end()));
+        return read<T>(fspace, transfer);
+    }
+
+    /**
+     * Strings are written in the data set's own string format, so that a
+     * StringArray without a width can fill a fixed-length data set, and the
+     * reverse.
+     */
+    void write(const StringArray& value, const Dataspace& fspace, Transfer transfer=Transfer::independent)
+    {
+        detail::api_lock lock;
+        auto type = string_type();
+        auto mspace = Dataspace{value.size()};
+        auto dxpl = PropertyList::dataset_transfer(transfer);
+
+        if (H5Tis_variable_str(type.id) > 0)
+        {
+            auto pointers = std::vector<const char*>(value.size());
+
+            for (std::size_t i = 0; i < value.size(); ++i)
+            {
+                pointers[i] = value.arena.data() + value.offsets[i];
+            }
+            detail::check(H5Dwrite(link.id, type.id, mspace.id, fspace.id, dxpl.id, pointers.data()));
+        }
+        else
+        {
+            auto width = type.size();
+            auto buffer = std::vector<char>(value.size() * width, '\0');
+
+            for (std::size_t i = 0; i < value.size(); ++i)
+            {
+                if (value[i].size() > width)
+                {
+                    throw std::invalid_argument("string is longer than the fixed length of the data set");
+                }
+                std::copy(value[i].begin(), value[i].end(), buffer.begin() + i * width);
+            }
+            detail::check(H5Dwrite(link.id, type.id, mspace.id, fspace.id, dxpl.id, buffer.data()));
+        }
+    }
+
+    void write(const std::vector<std::string>& value, const Dataspace& fspace, Transfer transfer=Transfer::independent)
+    {
+        write(StringArray(value), fspace, transfer);
+    }
+
+    template<typename T>
+    T read(const Dataspace& fspace, Transfer transfer=Transfer::independent)
+    {
+        T value;
+        read_into(value, fspace, transfer);
+        return value;
+    }
+
+    /**
+     * Return the runs of bytes in the file holding the selected elements,
+     * for data sets stored contiguously or in unfiltered chunks, in a file
+     * using the default (sec2) driver. Throws if the storage does not allow
+     * it, or is not yet allocated.
+     */
+    std::vector<ByteRun> byte_runs() const
+    {
+        return byte_runs(detail::hyperslab::full(get_space().extent()));
+    }
+
+    template<typename Selector>
+    std::vector<ByteRun> byte_runs(Selector sel) const
+    {
+        auto extent = get_space().extent();
+        return byte_runs(detail::hyperslab(nd::with_count(sel, extent.begin(), extent.end())));
+    }
+
+    /**
+     * Read a selection by issuing its byte runs as parallel preadv calls,
+     * outside of HDF5. Falls back to an ordinary read when the byte runs are
+     * not available.
+     */
+    template<typename T>
+    T read_parallel(unsigned threads)
+    {
+        return read_runs<T>(detail::hyperslab::full(get_space().extent()), threads);
+    }
+
+    template<typename T, typename Selector>
+    T read_parallel(Selector sel, unsigned threads)
+    {
+        auto extent = get_space().extent();
+        return read_runs<T>(detail::hyperslab(nd::with_count(sel, extent.begin(), extent.end())), threads);
+    }
+
+    template<typename T>
+    BufferedWriter<T> buffered(std::size_t threshold=1 << 20)
+    {
+        return BufferedWriter<T>(reopen(), threshold);
+    }
+
+    template<typename T>
+    TileQueue<T> tile_queue(std::size_t threshold=1 << 20)
+    {
+        return TileQueue<T>(buffered<T>(threshold));
+    }
+
+    template<typename T, typename = std::enable_if_t<! std::is_lvalue_reference<T>::value>>
+    std::future<void> write_async(T&& value)
+    {
+        auto dset = share();
+        auto data = std::make_shared<T>(std::move(value));
+        return io_thread().submit([dset, data] { dset->write(*data); });
+    }
+
+    template<typename T>
+    std::future<void> write_async(std::reference_wrapper<const T> value)
+    {
+        auto dset = share();
+        return io_thread().submit([dset, value] { dset->write(value.get()); });
+    }
+
+    template<typename T, typename Selector, typename = std::enable_if_t<! std::is_lvalue_reference<T>::value>>
+    std::future<void> write_async(T&& value, Selector sel)
+    {
+        auto dset = share();
+        auto data = std::make_shared<T>(std::move(value));
+        return io_thread().submit([dset, data, sel] { dset->write(*data, sel); });
+    }
+
+    template<typename T, typename Selector>
+    std::future<void> write_async(std::reference_wrapper<const T> value, Selector sel)
+    {
+        auto dset = share();
+        return io_thread().submit([dset, value, sel] { dset->write(value.get(), sel); });
+    }
+
+    template<typename T>
+    std::future<T> read_async()
+    {
+        auto dset = share();
+        return io_thread().submit([dset] { return dset->template read<T>(); });
+    }
+
+    template<typename T, typename Selector>
+    std::future<T> read_async(Selector sel)
+    {
+        auto dset = share();
+        return io_thread().submit([dset, sel] { return dset->template read<T>(sel); });
+    }
+
+private:
+    // ========================================================================
+    template<typename T>
+    void read_into(T& value, const Dataspace& fspace, Transfer transfer)
+    {
+        detail::api_lock lock;
+        detail::prepare(get_type(), fspace, value);
+        auto data = detail::get_address(value);
+        auto type = detail::make_datatype_for(value);
+        auto mspace = detail::make_dataspace_for(value);
+        auto dxpl = PropertyList::dataset_transfer(transfer);
+        check_compatible(type);
+        detail::check(H5Dread(link.id, type.id, mspace.id, fspace.id, dxpl.id, data));
+    }
+
+    void read_into(std::vector<std::string>& value, const Dataspace& fspace, Transfer transfer)
+    {
+        auto strings = StringArray();
+        read_into(strings, fspace, transfer);
+        value = strings.to_vector();
+    }
+
+    /**
+     * Variable-length strings are read with a memory manager that places
+     * them one after another in the arena, which is sized beforehand to
+     * hold them all. Fixed-length strings are read into a block and then
+     * copied into the arena without their padding.
+     */
+    void read_into(StringArray& value, const Dataspace& fspace, Transfer transfer)
+    {
+        detail::api_lock lock;
+        auto type = string_type();
+        auto count = fspace.selection_size();
+        auto mspace = Dataspace{count};
+        auto dxpl = PropertyList::dataset_transfer(transfer);
+
+        value = StringArray();
+        value.offsets.reserve(count + 1);
+
+        if (H5Tis_variable_str(type.id) > 0)
+        {
+            struct bump
+            {
+                char* next;
+                char* end;
+            };
+            auto allocate = [] (std::size_t size, void* info) -> void*
+            {
+                auto& b = *static_cast<bump*>(info);
+
+                if (std::size_t(b.end - b.next) < size)
+                {
+                    return nullptr;
+                }
+                auto result = b.next;
+                b.next += size;
+                return result;
+            };
+            auto release = [] (void*, void*) {};
+            auto bytes = hsize_t(0);
+            detail::check(H5Dvlen_get_buf_size(link.id, type.id, fspace.id, &bytes));
+
+            if (dxpl.id == H5P_DEFAULT)
+            {
+                dxpl = PropertyList::dataset_transfer();
+            }
+            value.arena.resize(bytes);
+            auto arena = bump{value.arena.data(), value.arena.data() + bytes};
+            auto pointers = std::vector<char*>(count);
+            detail::check(H5Pset_vlen_mem_manager(dxpl.id, allocate, &arena, release, nullptr));
+            detail::check(H5Dread(link.id, type.id, mspace.id, fspace.id, dxpl.id, pointers.data()));
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (pointers[i] != value.arena.data() + value.offsets.back())
+                {
+                    // Unexpected layout, such as null strings: rebuild the arena.
+                    auto arena_copy = std::vector<char>();
+                    std::swap(arena_copy, value.arena);
+                    value.offsets = {0};
+
+                    for (auto p : pointers)
+                    {
+                        value.push_back(p ? StringView(p) : StringView());
+                    }
+                    return;
+                }
+                value.offsets.push_back(value.offsets.back() + std::strlen(pointers[i]) + 1);
+            }
+            value.arena.resize(value.offsets.back());
+        }
+        else
+        {
+            auto width = type.size();
+            auto padding = H5Tget_strpad(type.id);
+            auto buffer = std::vector<char>(count * width);
+            detail::check(H5Dread(link.id, type.id, mspace.id, fspace.id, dxpl.id, buffer.data()));
+            value.arena.reserve(buffer.size() + count);
+            value.string_width = width;
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto first = buffer.data() + i * width;
+                auto last = std::find(first, first + width, '\0');
+
+                if (padding == H5T_STR_SPACEPAD)
+                {
+                    while (last != first && last[-1] == ' ') --last;
+                }
+                value.push_back(StringView(first, last - first));
+            }
+        }
+    }
+
+    /**
+     * Return the memory type for the data set's strings, which must be
+     * either fixed-length or variable-length C strings.
+     */
+    Datatype string_type() const
+    {
+        auto type = get_type();
+        detail::api_lock lock;
+
+        if (H5Tget_class(type.id) != H5T_STRING)
+        {
+            throw std::invalid_argument("source and target have different data types");
+        }
+        return type;
+    }
+
+    Datatype check_compatible(const Datatype& type) const
+    {
+        if (type != get_type())
+        {
+            throw std::invalid_argument("source and target have different data types");
+        }
+        return type;
+    }
+
+    void write_raw(const void* data, const Datatype& type, const Dataspace& mspace)
+    {
+        write_raw(data, type, mspace, get_space());
+    }
+
+    void write_raw(const void* data, const Datatype& type, const Dataspace& mspace, const Dataspace& fspace)
+    {
+        detail::api_lock lock;
+        check_compatible(type);
+        detail::check(H5Dwrite(link.id, type.id, mspace.id, fspace.id, H5P_DEFAULT, data));
+    }
+
+    std::vector<ByteRun> byte_runs(const detail::hyperslab& slab) const
+    {
+        auto runs = std::vector<ByteRun>();
+
+        if (! plan_runs(slab, runs))
+        {
+            throw std::invalid_argument("data set storage does not support direct byte access");
+        }
+        return runs;
+    }
+
+    template<typename T>
+    T read_runs(detail::hyperslab slab, unsigned threads)
+    {
+        auto fspace = get_space();
+
+        if (! slab.start.empty())
+        {
+            slab.select(fspace.id);
+        }
+#ifdef __linux__
+        auto runs = std::vector<ByteRun>();
+
+        if (plan_runs(slab, runs))
+        {
+            T value;
+            detail::prepare(get_type(), fspace, value);
+            check_compatible(detail::make_datatype_for(value));
+            detail::pread_runs(file_name(), runs, static_cast<char*>(detail::get_address(value)), threads);
+            return value;
+        }
+#else
+        (void) threads;
+#endif
+        return read<T>(fspace);
+    }
+
+    bool plan_runs(const detail::hyperslab& slab, std::vector<ByteRun>& runs) const
+    {
+        detail::api_lock lock;
+        auto dcpl = PropertyList(detail::check(H5Dget_create_plist(link.id)));
+        auto file = detail::check(H5Iget_file_id(link.id));
+        auto fapl = PropertyList(H5Fget_access_plist(file));
+        auto intent = 0u;
+        H5Fget_intent(file, &intent);
+        H5Fclose(file);
+
+        // Variable-length elements are stored as references into the
+        // global heap, so their bytes in the file are not the values.
+        auto type = get_type();
+
+        if (H5Pget_nfilters(dcpl.id) != 0 ||
+            H5Pget_external_count(dcpl.id) != 0 ||
+            H5Pget_driver(fapl.id) != H5FD_SEC2 ||
+            H5Tdetect_class(type.id, H5T_VLEN) > 0 ||
+            H5Tis_variable_str(type.id) > 0)
+        {
+            return false;
+        }
+        if (intent & H5F_ACC_RDWR)
+        {
+            detail::check(H5Dflush(link.id));
+        }
+
+        auto extent = get_space().extent();
+        auto rank = extent.size();
+        auto esize = type.size();
+        auto chunk = std::vector<hsize_t>(extent.begin(), extent.end());
+        auto base = haddr_t(HADDR_UNDEF);
+        auto layout = H5Pget_layout(dcpl.id);
+
+        if (layout == H5D_CONTIGUOUS)
+        {
+            base = H5Dget_offset(link.id);
+
+            if (base == HADDR_UNDEF)
+            {
+                return false;
+            }
+        }
+#if H5_VERSION_GE(1, 10, 5)
+        else if (layout == H5D_CHUNKED)
+        {
+            detail::check(H5Pget_chunk(dcpl.id, int(rank), chunk.data()));
+        }
+#endif
+        else
+        {
+            return false;
+        }
+        if (rank == 0)
+        {
+            runs.push_back({base, 0, esize});
+            return true;
+        }
+
+        auto addresses = std::map<std::vector<hsize_t>, haddr_t>();
+        auto address_of = [&] (const std::vector<hsize_t>& origin) -> haddr_t
+        {
+            if (layout == H5D_CONTIGUOUS)
+            {
+                return base;
+            }
+#if H5_VERSION_GE(1, 10, 5)
+            auto found = addresses.find(origin);
+
+            if (found == addresses.end())
+            {
+                auto mask = 0u;
+                auto addr = haddr_t(HADDR_UNDEF);
+                auto size = hsize_t(0);
+
+                if (H5Dget_chunk_info_by_coord(link.id, origin.data(), &mask, &addr, &size) < 0)
+                {
+                    addr = HADDR_UNDEF;
+                }
+                found = addresses.emplace(origin, addr).first;
+            }
+            return found->second;
+#else
+            return HADDR_UNDEF;
+#endif
+        };
+
+        auto rows = hsize_t(1);
+        auto last = rank - 1;
+
+        for (std::size_t d = 0; d < rank; ++d)
+        {
+            if (slab.count[d] == 0)
+            {
+                return true;
+            }
+            rows *= d < last ? slab.count[d] : 1;
+        }
+
+        auto index = std::vector<hsize_t>(rank, 0);
+        auto coord = std::vector<hsize_t>(rank, 0);
+        auto origin = std::vector<hsize_t>(rank, 0);
+        auto memory = std::size_t(0);
+
+        for (hsize_t row = 0; row < rows; ++row)
+        {
+            for (std::size_t d = 0; d < last; ++d)
+            {
+                coord[d] = slab.start[d] + index[d] * slab.skips[d];
+            }
+            for (hsize_t j = 0; j < slab.count[last];)
+            {
+                coord[last] = slab.start[last] + j * slab.skips[last];
+
+                auto n = slab.skips[last] == 1
+                ? std::min(slab.count[last] - j, chunk[last] - coord[last] % chunk[last])
+                : hsize_t(1);
+                auto offset = hsize_t(0);
+
+                for (std::size_t d = 0; d < rank; ++d)
+                {
+                    origin[d] = coord[d] / chunk[d] * chunk[d];
+                    offset = offset * chunk[d] + coord[d] % chunk[d];
+                }
+                auto addr = address_of(origin);
+
+                if (addr == HADDR_UNDEF)
+                {
+                    return false;
+                }
+                auto run = ByteRun{addr + offset * esize, memory, n * esize};
+
+                if (! runs.empty() &&
+                    runs.back().file_offset + runs.back().length == run.file_offset &&
+                    runs.back().memory_offset + runs.back().length == run.memory_offset)
+                {
+                    runs.back().length += run.length;
+                }
+                else
+                {
+                    runs.push_back(run);
+                }
+                memory += run.length;
+                j += n;
+            }
+            for (std::size_t d = last; d-- > 0;)
+            {
+                if (++index[d] < slab.count[d])
+                {
+                    break;
+                }
+                index[d] = 0;
+            }
+        }
+        return true;
+    }
+
+    std::string file_name() const
+    {
+        detail::api_lock lock;
+        auto size = detail::check(H5Fget_name(link.id, nullptr, 0));
+        auto name = std::string(size, '\0');
+        detail::check(H5Fget_name(link.id, &name[0], size + 1));
+        return name;
+    }
+
+    void read_raw(void* data, const Datatype& type, const Dataspace& mspace, const Dataspace& fspace)
+    {
+        detail::api_lock lock;
+        check_compatible(type);
+        detail::check(H5Dread(link.id, type.id, mspace.id, fspace.id, H5P_DEFAULT, data));
+    }
+
+    /**
+     * The type in memory corresponding to the data set's type in the file,
+     * which differs from it if, for example, the file is big-endian.
+     */
+    Datatype get_native_type() const
+    {
+        detail::api_lock lock;
+        auto type = get_type();
+        return detail::check(H5Tget_native_type(type.id, H5T_DIR_ASCEND));
+    }
+
+    /**
+     * Read the selection converted to the native type.
+     */
+    void read_native(void* data, const Dataspace& mspace, const Dataspace& fspace)
+    {
+        detail::api_lock lock;
+        auto type = get_native_type();
+        detail::check(H5Dread(link.id, type.id, mspace.id, fspace.id, H5P_DEFAULT, data));
+    }
+
+    Dataset reopen() const
+    {
+        detail::api_lock lock;
+        detail::check(H5Iinc_ref(link.id));
+        return Link(link.id);
+    }
+
+    std::shared_ptr<Dataset> share() const
+    {
+        return std::shared_ptr<Dataset>(new Dataset(reopen()));
+    }
+
+    // ========================================================================
+    template <class GroupType, class DatasetType>
+    friend class Location;
+    template<typename T> friend class BufferedWriter;
+    template<typename T> friend std::vector<T> detail::read_range(Dataset&, std::size_t, std::size_t, unsigned);
+    friend class Checkpoint;
+    friend class RolloverWriter;
+    friend class Table;
+#ifdef __linux__
+    friend class ReaderPool;
+#endif
+
+    Dataset(Link link) : link(std::move(link)) {}
+    Link link;
+};
+
+
+
+
+// ============================================================================
+/**
+ * Write data to a one-dimensional data set starting at the given index,
+ * growing it if needed.
+ */
+template<typename T>
+void h5::detail::extend(Dataset& dset, std::size_t start, const std::vector<T>& data)
+{
+    if (data.empty())
+    {
+        return;
+    }
+    if (start + data.size() > dset.get_space().size())
+    {
+        dset.resize({start + data.size()});
+    }
+    auto fspace = dset.get_space();
+    auto slab = hyperslab::full({data.size()});
+    slab.start[0] = start;
+    slab.select(fspace.id);
+    dset.write(data, fspace);
+}
+
+/**
+ * Read the elements [first, last) of a one-dimensional data set as a single
+ * hyperslab. Only if more than one thread is requested are they read as
+ * parallel byte runs, where the storage allows.
+ */
+template<typename T>
+std::vector<T> h5::detail::read_range(Dataset& dset, std::size_t first, std::size_t last, unsigned threads)
+{
+    if (first == last)
+    {
+        return {};
+    }
+    auto slab = hyperslab::full({last - first});
+    slab.start[0] = first;
+
+    if (threads > 1)
+    {
+        return dset.read_runs<std::vector<T>>(slab, threads);
+    }
+    auto fspace = dset.get_space();
+    slab.select(fspace.id);
+    return dset.read<std::vector<T>>(fspace);
+}
+
+
+
+
+// ============================================================================
+/**
+ * Accumulates small writes to adjacent regions of a data set in memory, and
+ * issues them as a single H5Dwrite. The buffer is flushed when it exceeds
+ * the threshold (in bytes), when a write is not adjacent to the current
+ * region, and on destruction. Call flush() explicitly to observe errors.
+ * A flush that fails discards the buffered values before rethrowing, so
+ * one failed batch does not make every later flush fail.
+ */
+template<typename T>
+class h5::BufferedWriter final
+{
+public:
+
+    BufferedWriter(const BufferedWriter&) = delete;
+
+    BufferedWriter(BufferedWriter&& other) = default;
+
+    BufferedWriter& operator=(BufferedWriter&& other)
+    {
+        flush();
+        dset.close();
+        dset = std::move(other.dset);
+        region = std::move(other.region);
+        buffer = std::move(other.buffer);
+        extent = std::move(other.extent);
+        threshold = other.threshold;
+        num_flushes = other.num_flushes;
+        return *this;
+    }
+
+    ~BufferedWriter()
+    {
+        try {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    template<typename Selector>
+    void write(const T& value, Selector sel)
+    {
+        write(&value, 1, sel);
+    }
+
+    template<typename Selector>
+    void write(const std::vector<T>& value, Selector sel)
+    {
+        write(value.data(), value.size(), sel);
+    }
+
+    void flush()
+    {
+        if (buffer.empty())
+        {
+            return;
+        }
+        try {
+            auto fspace = dset.get_space();
+            region.select(fspace.id);
+            dset.write(buffer, fspace);
+        }
+        catch (...)
+        {
+            buffer.clear();
+            throw;
+        }
+        buffer.clear();
+        ++num_flushes;
+    }
+
+    std::size_t pending() const
+    {
+        return buffer.size();
+    }
+
+    std::size_t flushes() const
+    {
+        return num_flushes;
+    }
+
+private:
+    // ========================================================================
+    template<typename Selector>
+    void write(const T* data, std::size_t size, Selector sel)
+    {
+        write(data, size, detail::hyperslab(nd::with_count(sel, extent.begin(), extent.end())));
+    }
+
+    void write(const T* data, std::size_t size, detail::hyperslab slab)
+    {
+        auto count = std::size_t(1);
+
+        for (auto c : slab.count)
+        {
+            count *= c;
+        }
+        if (count != size)
+        {
+            throw std::invalid_argument("selection size does not match the number of values");
+        }
+        if (! slab.within(extent))
+        {
+            // The data set may have been extended since the writer was made.
+            extent = dset.get_space().extent();
+
+            if (! slab.within(extent))
+            {
+                throw std::out_of_range("selection is outside the data set extent");
+            }
+        }
+        for (auto s : slab.skips)
+        {
+            if (s != 1)
+            {
+                auto fspace = dset.get_space();
+                flush();
+                slab.select(fspace.id);
+                dset.write(std::vector<T>(data, data + size), fspace);
+                return;
+            }
+        }
+        if (! buffer.empty() && ! extend_region(slab))
+        {
+            flush();
+        }
+        if (buffer.empty())
+        {
+            region = slab;
+        }
+        buffer.insert(buffer.end(), data, data + size);
+
+        if (buffer.size() * sizeof(T) >= threshold)
+        {
+            flush();
+        }
+    }
+
+    bool extend_region(const detail::hyperslab& slab)
+    {
+        // The slab may be appended along axis a if it begins where the region
+        // ends, matches it on every other axis, and all slower axes have a
+        // count of one, so that appending to the buffer preserves C order.
+        auto rank = region.start.size();
+
+        if (slab.start.size() != rank)
+        {
+            return false;
+        }
+        for (std::size_t a = 0; a < rank; ++a)
+        {
+            bool adjacent = slab.start[a] == region.start[a] + region.count[a];
+
+            for (std::size_t d = 0; d < rank; ++d)
+            {
+                if (d != a && (slab.start[d] != region.start[d] || slab.count[d] != region.count[d]))
+                {
+                    adjacent = false;
+                }
+                if (d < a && slab.count[d] != 1)
+                {
+                    adjacent = false;
+                }
+            }
+            if (adjacent)
+            {
+                region.count[a] += slab.count[a];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // ========================================================================
+    friend class Dataset;
+    template<typename U> friend class TileQueue;
+
+    BufferedWriter(Dataset dset, std::size_t threshold)
+    : dset(std::move(dset))
+    , extent(this->dset.get_space().extent())
+    , threshold(threshold)
+    {
+    }
+
+    Dataset dset;
+    detail::hyperslab region;
+    std::vector<T> buffer;
+    std::vector<std::size_t> extent;
+    std::size_t threshold = 0;
+    std::size_t num_flushes = 0;
+};
+
+
+
+
+// ============================================================================
+/**
+ * A lock-free queue of tiles to be written to a data set. Any number of
+ * threads may push() concurrently without touching HDF5; a single consumer
+ * calls drain() to write the tiles received so far. Tiles are sorted by
+ * their starting index and fed through a BufferedWriter, so that tiles
+ * which are adjacent along the slowest varying axis are written together.
+ */
+template<typename T>
+class h5::TileQueue final
+{
+public:
+
+    TileQueue(const TileQueue&) = delete;
+
+    TileQueue(TileQueue&& other)
+    : writer(std::move(other.writer))
+    , head(other.head.exchange(nullptr))
+    {
+    }
+
+    ~TileQueue()
+    {
+        try {
+            flush();
+        }
+        catch (...)
+        {
+        }
+        discard(head.exchange(nullptr));
+    }
+
+    template<typename Selector>
+    void push(std::vector<T> data, Selector sel)
+    {
+        const auto& extent = writer.extent;
+        auto node = new Node{detail::hyperslab(nd::with_count(sel, extent.begin(), extent.end())), std::move(data), nullptr};
+        node->next = head.load(std::memory_order_relaxed);
+
+        while (! head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::size_t drain()
+    {
+        auto tiles = std::vector<std::unique_ptr<Node>>();
+
+        for (auto node = head.exchange(nullptr, std::memory_order_acquire); node; node = node->next)
+        {
+            tiles.emplace_back(node);
+        }
+        std::reverse(tiles.begin(), tiles.end());
+        std::stable_sort(tiles.begin(), tiles.end(), [] (const auto& a, const auto& b)
+        {
+            return a->slab.start < b->slab.start;
+        });
+
+        // A tile which fails to write does not stop the others; the first
+        // error is rethrown once every tile has been handed to the writer.
+        auto error = std::exception_ptr();
+
+        for (const auto& tile : tiles)
+        {
+            try {
+                writer.write(tile->data.data(), tile->data.size(), tile->slab);
+            }
+            catch (...)
+            {
+                if (! error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return tiles.size();
+    }
+
+    void flush()
+    {
+        auto error = std::exception_ptr();
+
+        try {
+            drain();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        writer.flush();
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    bool empty() const
+    {
+        return head.load() == nullptr;
+    }
+
+    std::size_t flushes() const
+    {
+        return writer.flushes();
+    }
+
+private:
+    // ========================================================================
+    struct Node
+    {
+        detail::hyperslab slab;
+        std::vector<T> data;
+        Node* next;
+    };
+
+    static void discard(Node* node)
+    {
+        while (node)
+        {
+            auto next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    // ========================================================================
+    friend class Dataset;
+
+    TileQueue(BufferedWriter<T> writer) : writer(std::move(writer))
+    {
+    }
+
+    BufferedWriter<T> writer;
+    std::atomic<Node*> head {nullptr};
+};
+
+
+
+
+// ============================================================================
+template <class GroupType, class DatasetType>
+class h5::Location
+{
+public:
+
+    Location() {}
+
+    Location(const Group&) = delete;
+
+    Location(Location&& other)
+    {
+        link = std::move(other.link);
+    }
+
+    Location& operator=(Location&& other)
+    {
+        link = std::move(other.link);
+        return *this;
+    }
+
+    bool is_open() const
+    {
+        return link.id != -1;
+    }
+
+    std::size_t size() const
+    {
+        return link.size();
+    }
+
+    Link::iterator begin() const
+    {
+        return link.begin();
+    }
+
+    Link::iterator end() const
+    {
+        return link.end();
+    }
+
+    /**
+     * Return the names of all links in one pass, ordered by name or by
+     * creation order. Creation order is available for groups created with
+     * GroupOptions::track_creation_order.
+     */
+    std::vector<std::string> names(Order order=Order::name) const
+    {
+        return link.names(order == Order::creation ? H5_INDEX_CRT_ORDER : H5_INDEX_NAME);
+    }
+
+    GroupType operator[](const std::string& name)
+    {
+        return require_group(name);
+    }
+
+    GroupType open_group(const std::string& name)
+    {
+        return link.open_group(name);
+    }
+
+    GroupType require_group(const std::string& name)
+    {
+        if (link.contains(name, Object::group))
+        {
+            return open_group(name);
+        }
+        return link.create_group(name);
+    }
+
+    /**
+     * Open the group if it exists, or else create it with the given
+     * options. The options do not affect a group that already exists.
+     */
+    GroupType require_group(const std::string& name, const GroupOptions& options)
+    {
+        if (link.contains(name, Object::group))
+        {
+            return open_group(name);
+        }
+        return link.create_group(name, options.gcpl);
+    }
+
+    DatasetType open_dataset(const std::string& name)
+    {
+        return link.open_dataset(name);
+    }
+
+    /**
+     * Create every group and data set in the schema that does not already
+     * exist. Entries are visited in path order, and groups seen along the
+     * way are remembered, so that each entry needs one existence check.
+     * Existing data sets must match the schema's type and space.
+     */
+    void require_schema(const Schema& schema)
+    {
+        auto order = std::vector<const Schema::Entry*>();
+        auto known = std::set<std::string>();
+
+        for (const auto& entry : schema.entries)
+        {
+            order.push_back(&entry);
+        }
+        std::stable_sort(order.begin(), order.end(), [] (auto a, auto b) { return a->path < b->path; });
+
+        for (auto entry : order)
+        {
+            const auto& path = entry->path;
+            auto slash = path.find_last_of('/');
+            auto parent = slash == std::string::npos || slash == 0 ? std::string() : path.substr(0, slash);
+            auto exists = parent.empty() || known.count(parent)
+            ? link.exists_here(path, entry->object)
+            : link.contains(path, entry->object);
+
+            if (entry->object == Object::group && ! exists)
+            {
+                GroupType(link.create_group(path, entry->cpl));
+            }
+            else if (entry->object == Object::dataset && ! exists)
+            {
+                DatasetType(link.create_dataset(path, entry->type, entry->space, entry->cpl));
+            }
+            else if (entry->object == Object::dataset)
+            {
+                auto dset = DatasetType(link.open_dataset(path));
+
+                if (dset.get_type() != entry->type || dset.get_space() != entry->space)
+                {
+                    throw std::invalid_argument("data set " + path + " exists with a different type or space");
+                }
+            }
+            for (auto end = path.find('/', 1); end != std::string::npos; end = path.find('/', end + 1))
+            {
+                known.insert(path.substr(0, end));
+            }
+            if (entry->object == Object::group)
+            {
+                known.insert(path);
+            }
+        }
+    }
+
+    void create_external_link(const std::string& name, const std::string& filename, const std::string& path="/")
+    {
+        link.create_external_link(name, filename, path);
+    }
+
+    DatasetType require_dataset(const std::string& name,
+                                const Datatype& type,
+                                const Dataspace& space,
+                                const DatasetOptions& options=DatasetOptions())
+    {
+        if (link.contains(name, Object::dataset))
+        {
+            auto dset = open_dataset(name);
+
+            if (dset.get_type() == type &&
+                dset.get_space() == space)
+            {
+                return dset;
+            }
+            throw std::invalid_argument(
+                "data set with different type or space already exists");
+        }
+        return link.create_dataset(name, type, space, options.dcpl);
+    }
+
+    template<typename T>
+    DatasetType require_dataset(const std::string& name, const Dataspace& space={})
+    {
+        return require_dataset(name, detail::make_datatype_for(T()), space);
+    }
+
+    template<typename T>
+    DatasetType require_dataset(const std::string& name, const Dataspace& space, const DatasetOptions& options)
+    {
+        return require_dataset(name, detail::make_datatype_for(T()), space, options);
+    }
+
+    /**
+     * Open the ragged array stored in the named group, or create it with
+     * the given chunk size if the group does not exist.
+     */
+    template<typename T>
+    RaggedArray<T> require_ragged(const std::string& name, std::size_t chunk=4096)
+    {
+        if (chunk == 0)
+        {
+            throw std::invalid_argument("ragged array chunk size must be positive");
+        }
+        if (link.contains(name, Object::group))
+        {
+            return RaggedArray<T>(open_group(name), false, chunk);
+        }
+        return RaggedArray<T>(require_group(name), true, chunk);
+    }
+
+    /**
+     * Open the sparse matrix stored in the named group, or create it empty
+     * with the given number of columns and chunk size. The number of
+     * columns must match that of an existing matrix.
+     */
+    template<typename T>
+    SparseMatrix<T> require_sparse(const std::string& name, std::size_t cols, std::size_t chunk=1 << 16)
+    {
+        if (chunk == 0)
+        {
+            throw std::invalid_argument("sparse matrix chunk size must be positive");
+        }
+        auto exists = link.contains(name, Object::group);
+        auto matrix = SparseMatrix<T>(require_group(name), ! exists, cols, chunk);
+
+        if (matrix.cols() != cols)
+        {
+            throw std::invalid_argument("sparse matrix exists with a different number of columns");
+        }
+        return matrix;
+    }
+
+    /**
+     * Open the table stored in the named group, or create it empty. Rows
+     * are written in batches of the given size, which is also the chunk
+     * size of new columns.
+     */
+    Table require_table(const std::string& name, std::size_t batch=4096);
+
+    template<typename T>
+    void write(const std::string& name, const T& value)
+    {
+        auto type = detail::make_datatype_for(value);
+        auto space = detail::make_dataspace_for(value, true);
+        require_dataset(name, type, space).write(value);
+    }
+
+    template<typename T, typename Selector>
+    void write(const std::string& name, const T& value, Selector sel)
+    {
+        auto type = detail::make_datatype_for(value);
+        auto space = detail::make_dataspace_for(value, true);
+        require_dataset(name, type, space).write(value, sel);
+    }
+
+    template<typename T>
+    T read(const std::string& name)
+    {
+        return open_dataset(name).template read<T>();
+    }
+
+    template<typename T, typename Selector>
+    T read(const std::string& name, Selector sel)
+    {
+        return open_dataset(name).template read<T>(sel);
+    }
+
+    template<typename T, typename = std::enable_if_t<! std::is_lvalue_reference<T>::value>>
+    std::future<void> write_async(const std::string& name, T&& value)
+    {
+        auto loc = share();
+        auto data = std::make_shared<T>(std::move(value));
+        return io_thread().submit([loc, name, data] { loc->write(name, *data); });
+    }
+
+    template<typename T>
+    std::future<void> write_async(const std::string& name, std::reference_wrapper<const T> value)
+    {
+        auto loc = share();
+        return io_thread().submit([loc, name, value] { loc->write(name, value.get()); });
+    }
+
+    template<typename T, typename Selector, typename = std::enable_if_t<! std::is_lvalue_reference<T>::value>>
+    std::future<void> write_async(const std::string& name, T&& value, Selector sel)
+    {
+        auto loc = share();
+        auto data = std::make_shared<T>(std::move(value));
+        return io_thread().submit([loc, name, data, sel] { loc->write(name, *data, sel); });
+    }
+
+    template<typename T, typename Selector>
+    std::future<void> write_async(const std::string& name, std::reference_wrapper<const T> value, Selector sel)
+    {
+        auto loc = share();
+        return io_thread().submit([loc, name, value, sel] { loc->write(name, value.get(), sel); });
+    }
+
+    template<typename T>
+    std::future<T> read_async(const std::string& name)
+    {
+        auto loc = share();
+        return io_thread().submit([loc, name] { return loc->template read<T>(name); });
+    }
+
+    template<typename T, typename Selector>
+    std::future<T> read_async(const std::string& name, Selector sel)
+    {
+        auto loc = share();
+        return io_thread().submit([loc, name, sel] { return loc->template read<T>(name, sel); });
+    }
+
+protected:
+    // ========================================================================
+    friend class Checkpoint;
+
+    Location(Link link) : link(std::move(link)) {}
+
+    std::shared_ptr<Location> share() const
+    {
+        detail::api_lock lock;
+        detail::check(H5Iinc_ref(link.id));
+
+        return std::shared_ptr<Location>(new Location(Link(link.id)), [] (Location* loc)
+        {
+            detail::api_lock lock;
+            H5Idec_ref(loc->link.id);
+            delete loc;
+        });
+    }
+
+    Link link;
+};
+
+
+
+
+// ============================================================================
+class h5::Group final : public Location<Group, Dataset>
+{
+public:
+    Group() {}
+
+    Group(const Group&) = delete;
+
+    Group(Group&& other)
+    {
+        link = std::move(other.link);
+    }
+
+    ~Group()
+    {
+        close();
+    }
+
+    Group& operator=(Group&& other)
+    {
+        link = std::move(other.link);
+        return *this;
+    }
+
+    void close()
+    {
+        link.close(Object::group);
+    }
+
+private:
+    template <class GroupType, class DatasetType> friend class h5::Location;
+    Group(Link link) : Location(std::move(link)) {}
+};
+
+
+
+
+// ============================================================================
+/**
+ * While a BurstMode obtained from File::burst exists, the file's metadata
+ * cache is held at a fixed, larger size and never evicts, so that creating
+ * many objects does not write metadata piecemeal. When it ends, the
+ * previous cache configuration is restored and the file is flushed once.
+ * The cache may grow beyond its size while evictions are off, so a burst
+ * should be scoped to the creation of a bounded number of objects.
+ */
+class h5::BurstMode final
+{
+public:
+
+    BurstMode(BurstMode&& other) : file(other.file), saved(other.saved)
+    {
+        other.file = -1;
+    }
+
+    BurstMode(const BurstMode&) = delete;
+
+    ~BurstMode()
+    {
+        try
+        {
+            end();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    /**
+     * Restore the cache configuration and flush the file. Errors are thrown
+     * from here, but are discarded if the burst ends by going out of scope.
+     */
+    void end()
+    {
+        if (file == -1)
+        {
+            return;
+        }
+        auto id = file;
+        file = -1;
+
+        detail::api_lock lock;
+        auto restored = H5Fset_mdc_config(id, &saved);
+        auto flushed = H5Fflush(id, H5F_SCOPE_GLOBAL);
+        H5Idec_ref(id);
+        detail::check(restored);
+        detail::check(flushed);
+    }
+
+private:
+    // ========================================================================
+    friend class File;
+
+    BurstMode(hid_t id, std::size_t cache_size) : file(id)
+    {
+        detail::api_lock lock;
+        detail::check(H5Iinc_ref(file));
+
+        try {
+            saved.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+            detail::check(H5Fget_mdc_config(file, &saved));
+
+            auto config = saved;
+            config.set_initial_size = true;
+            config.initial_size = cache_size;
+            config.min_size = std::min(config.min_size, cache_size);
+            config.max_size = std::max(config.max_size, cache_size);
+            config.incr_mode = H5C_incr__off;
+            config.flash_incr_mode = H5C_flash_incr__off;
+            config.decr_mode = H5C_decr__off;
+            config.evictions_enabled = false;
+            detail::check(H5Fset_mdc_config(file, &config));
+        }
+        catch (...)
+        {
+            H5Idec_ref(file);
+            throw;
+        }
+
+        // Restoring the saved configuration should not reset the size.
+        saved.set_initial_size = false;
+    }
+
+    hid_t file = -1;
+    H5AC_cache_config_t saved;
+};
+
+
+
+
+// ============================================================================
+class h5::File final : public Location<Group, Dataset>
+{
+public:
+
+    static bool exists(const std::string& filename)
+    {
+        detail::api_lock lock;
+        return H5Fis_hdf5(filename.data()) > 0;
+    }
+
+    File() {}
+
+    File(const std::string& filename, const std::string& mode="r")
+    {
+        link.id = open(filename, mode, PropertyList());
+    }
+
+    File(const std::string& filename, const std::string& mode, const FileOptions& options)
+    {
+        link.id = open(filename, mode, options.fapl, options.swmr_access, options.fcpl);
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    /**
+     * Open a file collectively on all ranks of the communicator, using the
+     * MPI-IO driver. Each rank may then read or write its own hyperslab of
+     * shared data sets, passing Transfer::collective to Dataset::read/write
+     * for collective I/O.
+     */
+    File(const std::string& filename, const std::string& mode, MPI_Comm comm, const CollectiveBuffering& hints={})
+    {
+        auto fapl = PropertyList::file_access();
+        auto info = MPI_Info();
+        MPI_Info_create(&info);
+        MPI_Info_set(info, "romio_cb_read", hints.read.data());
+        MPI_Info_set(info, "romio_cb_write", hints.write.data());
+
+        if (hints.nodes > 0)
+        {
+            MPI_Info_set(info, "cb_nodes", std::to_string(hints.nodes).data());
+        }
+        if (hints.buffer_size > 0)
+        {
+            MPI_Info_set(info, "cb_buffer_size", std::to_string(hints.buffer_size).data());
+        }
+        try {
+            detail::api_lock lock;
+            detail::check(H5Pset_fapl_mpio(fapl.id, comm, info));
+        }
+        catch (...)
+        {
+            MPI_Info_free(&info);
+            throw;
+        }
+        MPI_Info_free(&info);
+        link.id = open(filename, mode, fapl);
+    }
+#endif // H5_HAVE_PARALLEL
+
+    File(const File&) = delete;
+
+    File(File&& other)
+    {
+        link = std::move(other.link);
+    }
+
+    ~File()
+    {
+        close();
+    }
+
+    File& operator=(File&& other)
+    {
+        link = std::move(other.link);
+        return *this;
+    }
+
+    void close()
+    {
+        link.close(Object::file);
+    }
+
+    Intent intent() const
+    {
+        detail::api_lock lock;
+        unsigned intent;
+        detail::check(H5Fget_intent(link.id, &intent));
+
+        if (intent & H5F_ACC_SWMR_WRITE) return Intent::swmr_write;
+        if (intent & H5F_ACC_SWMR_READ)  return Intent::swmr_read;
+        if (intent & H5F_ACC_RDWR)       return Intent::rdwr;
+        return Intent::rdonly;
+    }
+
+    void start_swmr_write()
+    {
+        detail::api_lock lock;
+        detail::check(H5Fstart_swmr_write(link.id));
+    }
+
+    void flush()
+    {
+        detail::api_lock lock;
+        detail::check(H5Fflush(link.id, H5F_SCOPE_GLOBAL));
+    }
+
+    /**
+     * Begin a burst of metadata creation, which lasts until the returned
+     * object is destroyed or ended. The cache size may be at most 128 MiB.
+     */
+    BurstMode burst(std::size_t cache_size=64 << 20)
+    {
+        return BurstMode(link.id, cache_size);
+    }
+
+    /**
+     * Return the bounds on the file format versions the file was opened
+     * with. A bound equal to the newest format this library writes is
+     * reported as latest.
+     */
+    std::pair<LibraryVersion, LibraryVersion> library_versions() const
+    {
+        auto version = [] (H5F_libver_t v)
+        {
+            if (v == H5F_LIBVER_LATEST) return LibraryVersion::latest;
+            if (v == H5F_LIBVER_EARLIEST) return LibraryVersion::earliest;
+#if H5_VERSION_GE(1, 10, 2)
+            if (v == H5F_LIBVER_V18) return LibraryVersion::v18;
+#endif
+            return LibraryVersion::v110;
+        };
+        detail::api_lock lock;
+        auto fapl = PropertyList(detail::check(H5Fget_access_plist(link.id)));
+        auto low = H5F_LIBVER_EARLIEST;
+        auto high = H5F_LIBVER_LATEST;
+        detail::check(H5Pget_libver_bounds(fapl.id, &low, &high));
+        return std::make_pair(version(low), version(high));
+    }
+
+#if H5_VERSION_GE(1, 10, 1)
+    /**
+     * Return the size in bytes of the metadata cache image stored in the
+     * file, or zero if there is none.
+     */
+    std::size_t metadata_cache_image_size() const
+    {
+        detail::api_lock lock;
+        auto address = haddr_t(HADDR_UNDEF);
+        auto length = hsize_t(0);
+        detail::check(H5Fget_mdc_image_info(link.id, &address, &length));
+        return address == HADDR_UNDEF ? 0 : length;
+    }
+#endif
+
+    /**
+     * Return the counters of a file opened with FileOptions::block_cache.
+     */
+    CacheStatistics cache_statistics() const
+    {
+        detail::api_lock lock;
+        auto name = std::string(detail::check(H5Fget_name(link.id, nullptr, 0)), '\0');
+        H5Fget_name(link.id, &name[0], name.size() + 1);
+        return detail::cache_driver::statistics(name);
+    }
+
+private:
+    // ========================================================================
+    static hid_t open(const std::string& filename, const std::string& mode, const PropertyList& fapl, bool swmr=false, const PropertyList& fcpl=PropertyList())
+    {
+        detail::api_lock lock;
+
+        if (mode == "r")
+        {
+            return detail::check(H5Fopen(filename.data(), H5F_ACC_RDONLY | (swmr ? H5F_ACC_SWMR_READ : 0), fapl.id));
+        }
+        else if (mode == "r+")
+        {
+            return detail::check(H5Fopen(filename.data(), H5F_ACC_RDWR | (swmr ? H5F_ACC_SWMR_WRITE : 0), fapl.id));
+        }
+        else if (mode == "w")
+        {
+            if (swmr)
+            {
+                throw std::invalid_argument("call File::start_swmr_write after creating data sets");
+            }
+            return detail::check(H5Fcreate(filename.data(), H5F_ACC_TRUNC, fcpl.id, fapl.id));
+        }
+        throw std::invalid_argument("File mode must be r, r+, or w");
+    }
+
+    File(Link link) : Location(std::move(link)) {}
+};
+
+
+
+
+// ============================================================================
+/**
+ * Writes a set of registered values to a location in the background. Each
+ * call to write() copies the values into one of two staging buffers, which
+ * is the only time the caller is stalled, and then writes and flushes them
+ * on the I/O thread. A checkpoint can therefore be staged while the one
+ * before it is being written. If both buffers are still in use, write()
+ * waits for the older checkpoint before staging, and rethrows any error it
+ * raised.
+ */
+class h5::Checkpoint final
+{
+public:
+
+    Checkpoint(const Location<Group, Dataset>& location) : location(location.share())
+    {
+    }
+
+    Checkpoint(const Checkpoint&) = delete;
+
+    Checkpoint(Checkpoint&&) = default;
+
+    ~Checkpoint()
+    {
+        for (auto& slot : slots)
+        {
+            if (slot.pending.valid())
+            {
+                slot.pending.wait();
+            }
+        }
+    }
+
+    template<typename T>
+    Checkpoint& add(const std::string& name, const T& value)
+    {
+        auto entry = std::make_shared<Entry>();
+        entry->name = name;
+        entry->stage = [&value] (Staged& e)
+        {
+            e.type = detail::make_datatype_for(value);
+            e.mspace = detail::make_dataspace_for(value);
+            e.fspace = detail::make_dataspace_for(value, true);
+            auto data = static_cast<const char*>(detail::get_address(value));
+            e.bytes.assign(data, data + e.mspace.size() * e.type.size());
+        };
+        entries.push_back(entry);
+        return *this;
+    }
+
+    /**
+     * Strings are staged as a copy, in a StringArray, and written as
+     * variable-length strings from pointers into that copy.
+     */
+    Checkpoint& add(const std::string& name, const StringArray& value)
+    {
+        auto entry = std::make_shared<Entry>();
+        entry->name = name;
+        entry->stage = [&value] (Staged& e) { stage_strings(e, value); };
+        entries.push_back(entry);
+        return *this;
+    }
+
+    Checkpoint& add(const std::string& name, const std::vector<std::string>& value)
+    {
+        auto entry = std::make_shared<Entry>();
+        entry->name = name;
+        entry->stage = [&value] (Staged& e) { stage_strings(e, StringArray(value)); };
+        entries.push_back(entry);
+        return *this;
+    }
+
+    std::shared_future<void> write(const std::string& group="")
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto& slot = slots[next_slot];
+        next_slot = 1 - next_slot;
+
+        // The slot was last used by the checkpoint before the previous one,
+        // which the I/O thread wrote first.
+        finish(slot.pending);
+        slot.staged.resize(entries.size());
+
+        for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+            if (! slot.staged[i])
+            {
+                slot.staged[i] = std::make_shared<Staged>();
+            }
+            slot.staged[i]->name = entries[i]->name;
+            entries[i]->stage(*slot.staged[i]);
+        }
+        stall = std::chrono::steady_clock::now() - start;
+
+        auto loc = location;
+        auto staged = slot.staged;
+
+        slot.pending = io_thread().submit([loc, staged, group]
+        {
+            if (group.empty())
+            {
+                write_entries(*loc, staged);
+            }
+            else
+            {
+                auto target = loc->require_group(group);
+                write_entries(target, staged);
+            }
+            detail::api_lock lock;
+            detail::check(H5Fflush(loc->link.id, H5F_SCOPE_GLOBAL));
+        }).share();
+
+        return slot.pending;
+    }
+
+    /**
+     * Wait for both checkpoints in flight, and rethrow the error of the
+     * older one to fail, if any.
+     */
+    void wait()
+    {
+        auto error = std::exception_ptr();
+
+        for (int k = 0; k < 2; ++k)
+        {
+            try {
+                finish(slots[(next_slot + k) % 2].pending);
+            }
+            catch (...)
+            {
+                if (! error)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::chrono::duration<double> last_stall() const
+    {
+        return stall;
+    }
+
+private:
+    // ========================================================================
+    struct Staged
+    {
+        std::string name;
+        std::vector<char> bytes;
+        StringArray strings;
+        Datatype type;
+        Dataspace mspace;
+        Dataspace fspace;
+    };
+
+    struct Entry
+    {
+        std::string name;
+        std::function<void(Staged&)> stage;
+    };
+
+    struct Slot
+    {
+        std::vector<std::shared_ptr<Staged>> staged;
+        std::shared_future<void> pending;
+    };
+
+    static void finish(std::shared_future<void>& pending)
+    {
+        auto previous = std::move(pending);
+        pending = {};
+
+        if (previous.valid())
+        {
+            previous.get();
+        }
+    }
+
+    static void stage_strings(Staged& e, StringArray strings)
+    {
+        strings.fixed_length(0);
+        e.strings = std::move(strings);
+        e.type = detail::make_datatype_for(e.strings);
+        e.mspace = Dataspace{e.strings.size()};
+        e.fspace = Dataspace{e.strings.size()};
+        e.bytes.resize(e.strings.size() * sizeof(const char*));
+
+        for (std::size_t i = 0; i < e.strings.size(); ++i)
+        {
+            auto pointer = e.strings[i].data();
+            std::memcpy(e.bytes.data() + i * sizeof(const char*), &pointer, sizeof(const char*));
+        }
+    }
+
+    static void write_entries(Location<Group, Dataset>& target, const std::vector<std::shared_ptr<Staged>>& staged)
+    {
+        for (const auto& entry : staged)
+        {
+            auto dset = target.require_dataset(entry->name, entry->type, entry->fspace);
+            dset.write_raw(entry->bytes.data(), entry->type, entry->mspace);
+        }
+    }
+
+    std::shared_ptr<Location<Group, Dataset>> location;
+    std::vector<std::shared_ptr<Entry>> entries;
+    Slot slots[2];
+    int next_slot = 0;
+    std::chrono::duration<double> stall {0};
+};
+
+
+
+// ============================================================================
+/**
+ * Appends records to a sequence of files, rolling over to a new file when
+ * the current one would exceed max_bytes of appended data, or has been open
+ * for longer than max_age. Each file is named prefix-NNNNNN.h5 and holds
+ * every data set added to the schema, as one-dimensional extensible data
+ * sets, so it can be read on its own once closed.
+ *
+ * A record is made of values appended to any of the data sets, followed by
+ * a call to commit(). The values are held in memory until then, and the
+ * rollover decision is made for the record as a whole, so a record is never
+ * split between files.
+ *
+ * The index file, prefix-index.h5, holds an external link segment-NNNNNN to
+ * each file, and the data sets start_time and end_time, giving the range of
+ * times committed to each closed file. It is updated and closed again at
+ * every rollover, so it can be read while writing continues. A writer on a
+ * prefix with an existing index continues its numbering after the files
+ * already listed there.
+ */
+class h5::RolloverWriter final
+{
+public:
+
+    RolloverWriter(
+        const std::string& prefix,
+        std::size_t max_bytes,
+        std::chrono::duration<double> max_age=std::chrono::duration<double>::max(),
+        const FileOptions& options=FileOptions())
+    : prefix(prefix)
+    , max_bytes(max_bytes)
+    , max_age(max_age)
+    , options(options)
+    {
+        if (File::exists(index_name()))
+        {
+            auto index = File(index_name(), "r+");
+
+            for (const auto& name : index.names())
+            {
+                if (name.compare(0, 8, "segment-") == 0)
+                {
+                    segment_count += 1;
+                }
+            }
+            return;
+        }
+        auto index = File(index_name(), "w");
+        index.require_dataset<double>("start_time", extensible(), DatasetOptions().chunks({64}));
+        index.require_dataset<double>("end_time", extensible(), DatasetOptions().chunks({64}));
+    }
+
+    RolloverWriter(const RolloverWriter&) = delete;
+
+    RolloverWriter(RolloverWriter&&) = default;
+
+    ~RolloverWriter()
+    {
+        try {
+            close();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    /**
+     * Add a data set to the schema of every file. The schema is fixed once
+     * the first record has been committed.
+     */
+    template<typename T>
+    RolloverWriter& add_dataset(const std::string& name, std::size_t chunk=4096)
+    {
+        if (started)
+        {
+            throw std::logic_error("data sets must be added before the first commit");
+        }
+        schema.emplace(name, Column{detail::make_datatype_for(T()), chunk, 0, Dataset(), {}});
+        return *this;
+    }
+
+    /**
+     * Add values to the current record of a data set in the schema.
+     */
+    template<typename T>
+    void append(const std::string& name, const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "appended values must be trivially copyable");
+        auto column = schema.find(name);
+
+        if (column == schema.end())
+        {
+            throw std::invalid_argument("data set " + name + " is not in the schema");
+        }
+        if (column->second.type != detail::make_datatype_for(T()))
+        {
+            throw std::invalid_argument("values for data set " + name + " have a different data type");
+        }
+        auto& c = column->second;
+        auto bytes = reinterpret_cast<const char*>(values.data());
+        c.pending.insert(c.pending.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    template<typename T>
+    void append(const std::string& name, const T& value)
+    {
+        append(name, std::vector<T>{value});
+    }
+
+    /**
+     * Write the current record, first rolling over to a new file if the
+     * record would take the current one past max_bytes, or the current one
+     * is older than max_age.
+     */
+    void commit(double time=now())
+    {
+        auto bytes = std::size_t(0);
+
+        for (const auto& column : schema)
+        {
+            bytes += column.second.pending.size();
+        }
+        if (bytes == 0)
+        {
+            return;
+        }
+        if (file.is_open() && segment_bytes > 0 &&
+            (segment_bytes + bytes > max_bytes || std::chrono::steady_clock::now() - opened >= max_age))
+        {
+            roll();
+        }
+        if (! file.is_open())
+        {
+            open_segment(time);
+        }
+        for (auto& column : schema)
+        {
+            auto& c = column.second;
+            auto count = c.pending.size() / c.type.size();
+
+            if (count == 0)
+            {
+                continue;
+            }
+            c.dset.resize({c.length + count});
+            auto fspace = c.dset.get_space();
+            auto slab = detail::hyperslab::full({count});
+            slab.start[0] = c.length;
+            slab.select(fspace.id);
+            c.dset.write_raw(c.pending.data(), c.type, Dataspace{count}, fspace);
+            c.length += count;
+            c.pending.clear();
+        }
+        segment_bytes += bytes;
+        start_time = std::min(start_time, time);
+        end_time = std::max(end_time, time);
+    }
+
+    /**
+     * Close the current file, if any, and record it in the index. The next
+     * commit opens a new file.
+     */
+    void roll()
+    {
+        if (! file.is_open())
+        {
+            return;
+        }
+        for (auto& column : schema)
+        {
+            column.second.dset.close();
+            column.second.length = 0;
+        }
+        file.close();
+
+        auto index = File(index_name(), "r+");
+        auto n = segment_count - 1;
+
+        for (auto name : {"start_time", "end_time"})
+        {
+            auto dset = index.open_dataset(name);
+            dset.resize({n + 1});
+            auto fspace = dset.get_space();
+            auto slab = detail::hyperslab::full({1});
+            slab.start[0] = n;
+            slab.select(fspace.id);
+            dset.write(std::vector<double>{name[0] == 's' ? start_time : end_time}, fspace);
+        }
+    }
+
+    /**
+     * Commit any pending values as a last record, and close the current
+     * file.
+     */
+    void close()
+    {
+        commit();
+        roll();
+    }
+
+    std::size_t segments() const
+    {
+        return segment_count;
+    }
+
+    std::string segment_name(std::size_t n) const
+    {
+        return prefix + "-" + number(n) + ".h5";
+    }
+
+    std::string index_name() const
+    {
+        return prefix + "-index.h5";
+    }
+
+    static double now()
+    {
+        auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+        return std::chrono::duration<double>(since_epoch).count();
+    }
+
+private:
+    // ========================================================================
+    struct Column
+    {
+        Datatype type;
+        std::size_t chunk;
+        std::size_t length;
+        Dataset dset;
+        std::vector<char> pending;
+    };
+
+    static std::string number(std::size_t n)
+    {
+        auto digits = std::to_string(n);
+        return std::string(digits.size() < 6 ? 6 - digits.size() : 0, '0') + digits;
+    }
+
+    static Dataspace extensible()
+    {
+        return Dataspace::simple(std::vector<std::size_t>{0}, std::vector<std::size_t>{Dataspace::unlimited});
+    }
+
+    void open_segment(double time)
+    {
+        auto name = segment_name(segment_count);
+        file = File(name, "w", options);
+
+        for (auto& column : schema)
+        {
+            auto& c = column.second;
+            c.dset = file.require_dataset(column.first, c.type, extensible(), DatasetOptions().chunks({c.chunk}));
+        }
+        // Link by the bare file name, which HDF5 resolves relative to the
+        // index file, so that the set of files can be moved together.
+        auto base = name.substr(name.find_last_of('/') + 1);
+        File(index_name(), "r+").create_external_link("segment-" + number(segment_count), base);
+
+        segment_bytes = 0;
+        segment_count += 1;
+        started = true;
+        start_time = end_time = time;
+        opened = std::chrono::steady_clock::now();
+    }
+
+    std::string prefix;
+    std::size_t max_bytes;
+    std::chrono::duration<double> max_age;
+    FileOptions options;
+    std::map<std::string, Column> schema;
+    File file;
+    std::size_t segment_count = 0;
+    std::size_t segment_bytes = 0;
+    bool started = false;
+    double start_time = 0;
+    double end_time = 0;
+    std::chrono::steady_clock::time_point opened;
+};
+
+
+
+
+// ============================================================================
+/**
+ * An array of variable-length rows, stored in a group as a flat data set of
+ * values and a data set of row offsets into it, with one more offset than
+ * there are rows. The offsets are held in memory, so finding a row costs
+ * nothing, and reading any range of consecutive rows is a single hyperslab
+ * read of the values. Appending a batch of rows extends each data set once.
+ */
+template<typename T>
+class h5::RaggedArray final
+{
+public:
+
+    RaggedArray(const RaggedArray&) = delete;
+
+    RaggedArray(RaggedArray&&) = default;
+
+    RaggedArray& operator=(RaggedArray&&) = default;
+
+    void append(const std::vector<T>& row)
+    {
+        append_flat(row, {row.size()});
+    }
+
+    void append(const std::vector<std::vector<T>>& rows)
+    {
+        auto flat = std::vector<T>();
+        auto sizes = std::vector<std::size_t>();
+        sizes.reserve(rows.size());
+
+        for (const auto& row : rows)
+        {
+            sizes.push_back(row.size());
+        }
+        flat.reserve(std::accumulate(sizes.begin(), sizes.end(), std::size_t(0)));
+
+        for (const auto& row : rows)
+        {
+            flat.insert(flat.end(), row.begin(), row.end());
+        }
+        append_flat(flat, sizes);
+    }
+
+    /**
+     * Append rows given as a flat array of values and the length of each
+     * row. The lengths must add up to the number of values.
+     */
+    void append_flat(const std::vector<T>& values, const std::vector<std::size_t>& sizes)
+    {
+        if (std::accumulate(sizes.begin(), sizes.end(), std::size_t(0)) != values.size())
+        {
+            throw std::invalid_argument("row sizes do not add up to the number of values");
+        }
+        auto new_offsets = std::vector<std::uint64_t>();
+        new_offsets.reserve(sizes.size());
+
+        for (auto size : sizes)
+        {
+            new_offsets.push_back((new_offsets.empty() ? offsets.back() : new_offsets.back()) + size);
+        }
+        detail::extend(values_dset, offsets.back(), values);
+        detail::extend(offsets_dset, offsets.size(), new_offsets);
+        offsets.insert(offsets.end(), new_offsets.begin(), new_offsets.end());
+    }
+
+    std::size_t size() const
+    {
+        return offsets.size() - 1;
+    }
+
+    std::size_t row_size(std::size_t i) const
+    {
+        check_range(i, i + 1);
+        return offsets[i + 1] - offsets[i];
+    }
+
+    /**
+     * The total number of values in all rows.
+     */
+    std::size_t values() const
+    {
+        return offsets.back();
+    }
+
+    std::vector<T> row(std::size_t i)
+    {
+        check_range(i, i + 1);
+        return read_values(offsets[i], offsets[i + 1]);
+    }
+
+    /**
+     * Read the rows in [first, last) with a single read of their values. If
+     * more than one thread is given, the values are instead read as parallel
+     * byte runs from the file, where the storage allows.
+     */
+    std::vector<std::vector<T>> rows(std::size_t first, std::size_t last, unsigned threads=1)
+    {
+        check_range(first, last);
+        auto flat = read_values(offsets[first], offsets[last], threads);
+        auto result = std::vector<std::vector<T>>();
+        result.reserve(last - first);
+
+        for (auto i = first; i < last; ++i)
+        {
+            result.emplace_back(
+                flat.begin() + std::ptrdiff_t(offsets[i] - offsets[first]),
+                flat.begin() + std::ptrdiff_t(offsets[i + 1] - offsets[first]));
+        }
+        return result;
+    }
+
+private:
+    // ========================================================================
+    template <class GroupType, class DatasetType> friend class h5::Location;
+
+    /**
+     * Create the data sets with the given chunk size, or else open them and
+     * load the offsets.
+     */
+    RaggedArray(Group group, bool create, std::size_t chunk) : group(std::move(group))
+    {
+        auto extensible = Dataspace::simple(std::vector<std::size_t>{0}, std::vector<std::size_t>{Dataspace::unlimited});
+
+        if (create)
+        {
+            values_dset = this->group.template require_dataset<T>("values", extensible, DatasetOptions().chunks({chunk}));
+            offsets_dset = this->group.template require_dataset<std::uint64_t>("offsets", extensible, DatasetOptions().chunks({chunk}));
+            detail::extend(offsets_dset, 0, offsets);
+        }
+        else
+        {
+            values_dset = this->group.open_dataset("values");
+            offsets_dset = this->group.open_dataset("offsets");
+
+            if (values_dset.get_type() != detail::make_datatype_for(T()))
+            {
+                throw std::invalid_argument("ragged array values have a different data type");
+            }
+            offsets = offsets_dset.template read<std::vector<std::uint64_t>>();
+
+            if (offsets.empty())
+            {
+                throw std::invalid_argument("ragged array has no offsets");
+            }
+        }
+    }
+
+    void check_range(std::size_t first, std::size_t last) const
+    {
+        if (first > last || last > size())
+        {
+            throw std::out_of_range("ragged array row index out of range");
+        }
+    }
+
+    std::vector<T> read_values(std::size_t first, std::size_t last, unsigned threads=1)
+    {
+        return detail::read_range<T>(values_dset, first, last, threads);
+    }
+
+    Group group;
+    Dataset values_dset;
+    Dataset offsets_dset;
+    std::vector<std::uint64_t> offsets = {0};
+};
+
+
+
+
+// ============================================================================
+/**
+ * A sparse matrix in compressed sparse row form: the column indices and
+ * values of row r are those in [indptr[r], indptr[r + 1]).
+ */
+template<typename T>
+struct h5::CsrMatrix
+{
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    std::vector<std::uint64_t> indptr = {0};
+    std::vector<std::uint64_t> indices;
+    std::vector<T> data;
+
+    std::size_t nnz() const
+    {
+        return data.size();
+    }
+};
+
+
+
+
+// ============================================================================
+/**
+ * A sparse matrix as a list of (row, column, value) triplets, for assembly.
+ */
+template<typename T>
+struct h5::CooMatrix
+{
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    std::vector<std::uint64_t> row;
+    std::vector<std::uint64_t> col;
+    std::vector<T> data;
+
+    void push_back(std::size_t r, std::size_t c, T value)
+    {
+        row.push_back(r);
+        col.push_back(c);
+        data.push_back(value);
+    }
+
+    std::size_t nnz() const
+    {
+        return data.size();
+    }
+
+    /**
+     * Convert to CSR form using the given number of threads. Each thread
+     * counts the entries per row in its share of the triplets, and then
+     * scatters them to positions found from those counts, so entries keep
+     * their triplet order within each row and duplicates are not summed.
+     * The counts take one integer per row per thread.
+     */
+    CsrMatrix<T> to_csr(unsigned threads=1) const
+    {
+        if (row.size() != data.size() || col.size() != data.size())
+        {
+            throw std::invalid_argument("triplet arrays have different sizes");
+        }
+        auto n = data.size();
+        auto t = std::size_t(std::max(1u, std::min(threads, unsigned(n / 4096 + 1))));
+        auto counts = std::vector<std::vector<std::uint64_t>>(t, std::vector<std::uint64_t>(rows));
+        std::atomic<bool> invalid(false);
+        auto result = CsrMatrix<T>();
+
+        parallel(t, [&] (std::size_t k)
+        {
+            for (auto i = n * k / t; i < n * (k + 1) / t; ++i)
+            {
+                if (row[i] >= rows || col[i] >= cols)
+                {
+                    invalid = true;
+                    return;
+                }
+                ++counts[k][row[i]];
+            }
+        });
+
+        if (invalid)
+        {
+            throw std::out_of_range("triplet index outside the matrix");
+        }
+        result.rows = rows;
+        result.cols = cols;
+        result.indptr.resize(rows + 1);
+        result.indices.resize(n);
+        result.data.resize(n);
+
+        for (std::size_t r = 0, total = 0; r < rows; ++r)
+        {
+            for (std::size_t k = 0; k < t; ++k)
+            {
+                auto count = counts[k][r];
+                counts[k][r] = total;
+                total += count;
+            }
+            result.indptr[r + 1] = total;
+        }
+
+        parallel(t, [&] (std::size_t k)
+        {
+            for (auto i = n * k / t; i < n * (k + 1) / t; ++i)
+            {
+                auto position = counts[k][row[i]]++;
+                result.indices[position] = col[i];
+                result.data[position] = data[i];
+            }
+        });
+        return result;
+    }
+
+private:
+    template<typename Function>
+    static void parallel(std::size_t threads, Function f)
+    {
+        auto workers = std::vector<std::thread>();
+
+        for (std::size_t k = 1; k < threads; ++k)
+        {
+            workers.emplace_back(f, k);
+        }
+        f(0);
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+};
+
+
+
+
+// ============================================================================
+/**
+ * A sparse matrix stored in CSR form in a group, as the data sets indptr,
+ * indices and data, with its dimensions in a data set named shape. Rows are
+ * appended in blocks. Reading a range of rows reads just its part of indptr,
+ * and then its slices of indices and data, so that only the requested rows
+ * are touched however large the matrix is. Each slice is one hyperslab
+ * read.
+ */
+template<typename T>
+class h5::SparseMatrix final
+{
+public:
+
+    SparseMatrix(const SparseMatrix&) = delete;
+
+    SparseMatrix(SparseMatrix&&) = default;
+
+    SparseMatrix& operator=(SparseMatrix&&) = default;
+
+    std::size_t rows() const
+    {
+        return num_rows;
+    }
+
+    std::size_t cols() const
+    {
+        return num_cols;
+    }
+
+    std::size_t nnz() const
+    {
+        return num_nonzero;
+    }
+
+    /**
+     * Append the rows of a block, which must have as many columns as the
+     * matrix. Each data set is extended with one write.
+     */
+    void append(const CsrMatrix<T>& block)
+    {
+        if (block.cols != num_cols ||
+            block.indptr.size() != block.rows + 1 ||
+            block.indptr.front() != 0 ||
+            block.indptr.back() != block.nnz() ||
+            block.indices.size() != block.nnz())
+        {
+            throw std::invalid_argument("block is not a valid CSR matrix with the same number of columns");
+        }
+        if (! std::is_sorted(block.indptr.begin(), block.indptr.end()))
+        {
+            throw std::invalid_argument("block row pointers are not monotonic");
+        }
+        for (auto index : block.indices)
+        {
+            if (index >= num_cols)
+            {
+                throw std::invalid_argument("block column index out of range");
+            }
+        }
+        auto indptr = std::vector<std::uint64_t>(block.indptr.begin() + 1, block.indptr.end());
+
+        for (auto& offset : indptr)
+        {
+            offset += num_nonzero;
+        }
+        detail::extend(indices_dset, num_nonzero, block.indices);
+        detail::extend(data_dset, num_nonzero, block.data);
+        detail::extend(indptr_dset, num_rows + 1, indptr);
+        num_rows += block.rows;
+        num_nonzero += block.nnz();
+        detail::extend(shape_dset, 0, std::vector<std::uint64_t>{num_rows, num_cols});
+    }
+
+    void append(const CooMatrix<T>& block, unsigned threads=1)
+    {
+        append(block.to_csr(threads));
+    }
+
+    /**
+     * Read the rows in [first, last) as a CSR matrix whose row 0 is the
+     * first row read. If more than one thread is given, the slices of
+     * indices and data are instead read as parallel byte runs from the
+     * file, where the storage allows.
+     */
+    CsrMatrix<T> read_rows(std::size_t first, std::size_t last, unsigned threads=1)
+    {
+        if (first > last || last > num_rows)
+        {
+            throw std::out_of_range("sparse matrix row index out of range");
+        }
+        auto result = CsrMatrix<T>();
+        result.rows = last - first;
+        result.cols = num_cols;
+        result.indptr = detail::read_range<std::uint64_t>(indptr_dset, first, last + 1);
+        auto begin = result.indptr.front();
+        auto end = result.indptr.back();
+
+        for (auto& offset : result.indptr)
+        {
+            offset -= begin;
+        }
+        result.indices = detail::read_range<std::uint64_t>(indices_dset, begin, end, threads);
+        result.data = detail::read_range<T>(data_dset, begin, end, threads);
+        return result;
+    }
+
+    CsrMatrix<T> read(unsigned threads=1)
+    {
+        return read_rows(0, num_rows, threads);
+    }
+
+private:
+    // ========================================================================
+    template <class GroupType, class DatasetType> friend class h5::Location;
+
+    /**
+     * Create the data sets with the given chunk size, or else open them and
+     * read the dimensions.
+     */
+    SparseMatrix(Group group, bool create, std::size_t cols, std::size_t chunk) : group(std::move(group)), num_cols(cols)
+    {
+        auto extensible = Dataspace::simple(std::vector<std::size_t>{0}, std::vector<std::size_t>{Dataspace::unlimited});
+        auto index_type = detail::make_datatype_for(std::uint64_t());
+        auto value_type = detail::make_datatype_for(T());
+
+        if (create)
+        {
+            auto options = DatasetOptions().chunks({chunk});
+            indptr_dset = this->group.require_dataset("indptr", index_type, extensible, options);
+            indices_dset = this->group.require_dataset("indices", index_type, extensible, options);
+            data_dset = this->group.require_dataset("data", value_type, extensible, options);
+            shape_dset = this->group.require_dataset("shape", index_type, Dataspace{2});
+            detail::extend(indptr_dset, 0, std::vector<std::uint64_t>{0});
+            detail::extend(shape_dset, 0, std::vector<std::uint64_t>{0, num_cols});
+        }
+        else
+        {
+            indptr_dset = this->group.open_dataset("indptr");
+            indices_dset = this->group.open_dataset("indices");
+            data_dset = this->group.open_dataset("data");
+            shape_dset = this->group.open_dataset("shape");
+
+            if (data_dset.get_type() != value_type)
+            {
+                throw std::invalid_argument("sparse matrix data have a different data type");
+            }
+            auto shape = shape_dset.template read<std::vector<std::uint64_t>>();
+            num_rows = shape.at(0);
+            num_cols = shape.at(1);
+            num_nonzero = detail::read_range<std::uint64_t>(indptr_dset, num_rows, num_rows + 1).at(0);
+        }
+    }
+
+    Group group;
+    Dataset indptr_dset;
+    Dataset indices_dset;
+    Dataset data_dset;
+    Dataset shape_dset;
+    std::size_t num_rows = 0;
+    std::size_t num_cols = 0;
+    std::size_t num_nonzero = 0;
+};
+
+
+
+
+// ============================================================================
+/**
+ * A range of rows read from some of the columns of a Table, held together
+ * in one buffer.
+ */
+class h5::TableRows final
+{
+public:
+
+    std::size_t size() const
+    {
+        return num_rows;
+    }
+
+    const std::vector<std::string>& columns() const
+    {
+        return names;
+    }
+
+    template<typename T>
+    std::vector<T> get(const std::string& column) const
+    {
+        auto i = index(column);
+
+        if (detail::make_datatype_for(T()) != types[i])
+        {
+            throw std::invalid_argument("column " + column + " has a different data type");
+        }
+        auto first = reinterpret_cast<const T*>(bytes.data() + offsets[i]);
+        return std::vector<T>(first, first + num_rows);
+    }
+
+private:
+    // ========================================================================
+    friend class Table;
+
+    std::size_t index(const std::string& column) const
+    {
+        auto i = std::find(names.begin(), names.end(), column);
+
+        if (i == names.end())
+        {
+            throw std::invalid_argument("column " + column + " was not read");
+        }
+        return std::size_t(i - names.begin());
+    }
+
+    std::size_t num_rows = 0;
+    std::vector<std::string> names;
+    std::vector<Datatype> types;
+    std::vector<std::size_t> offsets;
+    std::vector<char> bytes;
+};
+
+
+
+
+// ============================================================================
+/**
+ * A set of typed, one-dimensional columns in a group, extended together as
+ * rows of a table. Rows are buffered per column and written in batches, so
+ * that a batch costs one write per column. Columns are kept in the order
+ * they were added, using the group's creation order. Reads see the rows
+ * written so far, and flush any pending rows first. Pending rows are also
+ * flushed on destruction; call flush() explicitly to observe errors.
+ */
+class h5::Table final
+{
+public:
+
+    Table(const Table&) = delete;
+
+    Table(Table&&) = default;
+
+    ~Table()
+    {
+        try {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    /**
+     * Add a column, which must be done before any rows are appended. Adding
+     * a column that already exists with the same type does nothing.
+     */
+    template<typename T>
+    Table& add_column(const std::string& name)
+    {
+        auto type = detail::make_datatype_for(T());
+
+        for (const auto& column : table_columns)
+        {
+            if (column.name == name && column.type != type)
+            {
+                throw std::invalid_argument("column " + name + " exists with a different data type");
+            }
+            if (column.name == name)
+            {
+                return *this;
+            }
+        }
+        if (num_rows > 0 || pending_rows > 0)
+        {
+            throw std::logic_error("columns must be added before the first row");
+        }
+        auto extensible = Dataspace::simple(std::vector<std::size_t>{0}, std::vector<std::size_t>{Dataspace::unlimited});
+        auto dset = group.require_dataset(name, type, extensible, DatasetOptions().chunks({batch_rows}));
+        table_columns.push_back(Column{name, std::move(dset), type, type.size(), typeid(T), {}});
+        return *this;
+    }
+
+    std::vector<std::string> columns() const
+    {
+        auto names = std::vector<std::string>();
+
+        for (const auto& column : table_columns)
+        {
+            names.push_back(column.name);
+        }
+        return names;
+    }
+
+    /**
+     * The number of rows written to the file.
+     */
+    std::size_t size() const
+    {
+        return num_rows;
+    }
+
+    std::size_t pending() const
+    {
+        return pending_rows;
+    }
+
+    /**
+     * Append a row, giving one value for each column in column order.
+     */
+    template<typename... Ts>
+    void append_row(const Ts&... values)
+    {
+        if (sizeof...(Ts) != table_columns.size())
+        {
+            throw std::invalid_argument("row does not have one value per column");
+        }
+        auto i = std::size_t(0);
+        using expand = int[];
+        (void) expand{0, (check_type<Ts>(table_columns[i++]), 0)...};
+        i = 0;
+        (void) expand{0, (stage(table_columns[i++], values), 0)...};
+
+        if (++pending_rows >= batch_rows)
+        {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (pending_rows == 0)
+        {
+            return;
+        }
+        auto mspace = Dataspace{pending_rows};
+        auto slab = detail::hyperslab::full({pending_rows});
+        slab.start[0] = num_rows;
+
+        // The pending rows are kept until every column has been written, so
+        // that a failed flush leaves the table as it was and may be retried.
+        for (auto& column : table_columns)
+        {
+            column.dset.resize({num_rows + pending_rows});
+        }
+        for (auto& column : table_columns)
+        {
+            auto fspace = column.dset.get_space();
+            slab.select(fspace.id);
+            column.dset.write_raw(column.buffer.data(), column.type, mspace, fspace);
+        }
+        for (auto& column : table_columns)
+        {
+            column.buffer.clear();
+        }
+        num_rows += pending_rows;
+        pending_rows = 0;
+    }
+
+    template<typename T>
+    std::vector<T> read(const std::string& column, std::size_t first, std::size_t last)
+    {
+        flush();
+        check_range(first, last);
+        return detail::read_range<T>(find(column).dset, first, last);
+    }
+
+    /**
+     * Read the rows [first, last) of the named columns, or of every column
+     * if none are named. Where the storage allows, the byte runs of all the
+     * columns are gathered and read together by the given number of
+     * threads; otherwise each column is read in turn.
+     */
+    TableRows read_rows(std::size_t first, std::size_t last, std::vector<std::string> names={}, unsigned threads=1)
+    {
+        flush();
+        check_range(first, last);
+        auto rows = TableRows();
+        auto count = last - first;
+        auto selected = std::vector<Column*>();
+
+        if (names.empty())
+        {
+            names = columns();
+        }
+        // Rows are returned in the native representation of each column's
+        // type, which TableRows::get checks against the caller's type.
+        for (const auto& name : names)
+        {
+            selected.push_back(&find(name));
+            rows.types.push_back(selected.back()->dset.get_native_type());
+            rows.offsets.push_back(rows.bytes.size());
+            rows.bytes.resize(rows.bytes.size() + count * rows.types.back().size());
+        }
+        rows.num_rows = count;
+        rows.names = names;
+
+        if (count == 0)
+        {
+            return rows;
+        }
+        auto slab = detail::hyperslab::full({count});
+        slab.start[0] = first;
+
+#ifdef __linux__
+        auto runs = std::vector<ByteRun>();
+        auto planned = true;
+
+        // The bytes in the file are only the values in memory if the column
+        // is stored in its native representation.
+        for (std::size_t i = 0; i < selected.size() && planned; ++i)
+        {
+            auto column_runs = std::vector<ByteRun>();
+            planned = rows.types[i] == selected[i]->type && selected[i]->dset.plan_runs(slab, column_runs);
+
+            for (auto& run : column_runs)
+            {
+                run.memory_offset += rows.offsets[i];
+                runs.push_back(run);
+            }
+        }
+        if (planned)
+        {
+            detail::pread_runs(selected.front()->dset.file_name(), runs, rows.bytes.data(), threads);
+            return rows;
+        }
+#else
+        (void) threads;
+#endif
+        auto mspace = Dataspace{count};
+
+        for (std::size_t i = 0; i < selected.size(); ++i)
+        {
+            auto fspace = selected[i]->dset.get_space();
+            slab.select(fspace.id);
+            selected[i]->dset.read_native(rows.bytes.data() + rows.offsets[i], mspace, fspace);
+        }
+        return rows;
+    }
+
+private:
+    // ========================================================================
+    struct Column
+    {
+        std::string name;
+        Dataset dset;
+        Datatype type;
+        std::size_t size;
+        std::type_index checked;
+        std::vector<char> buffer;
+    };
+
+    template <class GroupType, class DatasetType> friend class h5::Location;
+
+    /**
+     * Open the columns already in the group, which must all have the same
+     * length.
+     */
+    Table(Group group, std::size_t batch) : group(std::move(group)), batch_rows(batch)
+    {
+        for (const auto& name : this->group.names(Order::creation))
+        {
+            auto dset = this->group.open_dataset(name);
+            auto type = dset.get_type();
+            auto length = dset.get_space().size();
+
+            if (! table_columns.empty() && length != num_rows)
+            {
+                throw std::invalid_argument("table columns have different lengths");
+            }
+            num_rows = length;
+            table_columns.push_back(Column{name, std::move(dset), type, type.size(), typeid(void), {}});
+        }
+    }
+
+    Column& find(const std::string& name)
+    {
+        for (auto& column : table_columns)
+        {
+            if (column.name == name)
+            {
+                return column;
+            }
+        }
+        throw std::invalid_argument("table has no column " + name);
+    }
+
+    void check_range(std::size_t first, std::size_t last) const
+    {
+        if (first > last || last > num_rows)
+        {
+            throw std::out_of_range("table row index out of range");
+        }
+    }
+
+    template<typename T>
+    static void check_type(Column& column)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "table values must be trivially copyable");
+
+        if (column.checked != typeid(T))
+        {
+            if (detail::make_datatype_for(T()) != column.type)
+            {
+                throw std::invalid_argument("value for column " + column.name + " has a different data type");
+            }
+            column.checked = typeid(T);
+        }
+    }
+
+    template<typename T>
+    static void stage(Column& column, const T& value)
+    {
+        auto bytes = reinterpret_cast<const char*>(&value);
+        column.buffer.insert(column.buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    Group group;
+    std::vector<Column> table_columns;
+    std::size_t batch_rows;
+    std::size_t num_rows = 0;
+    std::size_t pending_rows = 0;
+};
+
+template <class GroupType, class DatasetType>
+h5::Table h5::Location<GroupType, DatasetType>::require_table(const std::string& name, std::size_t batch)
+{
+    if (batch == 0)
+    {
+        throw std::invalid_argument("table batch size must be positive");
+    }
+    return Table(require_group(name, GroupOptions().track_creation_order()), batch);
+}
+
+
+
+
+#ifdef __linux__
+// ============================================================================
+/**
+ * A view of data gathered by a ReaderPool into shared memory. Views keep
+ * the shared memory mapped for as long as they exist.
+ */
+template<typename T>
+class h5::SharedView final
+{
+public:
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    T* begin() { return ptr; }
+    T* end() { return ptr + count; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    T& operator[](std::size_t i) { return ptr[i]; }
+    const T& operator[](std::size_t i) const { return ptr[i]; }
+    std::size_t size() const { return count; }
+    const std::vector<std::size_t>& shape() const { return dims; }
+    std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+
+private:
+    // ========================================================================
+    friend class ReaderPool;
+
+    SharedView(std::shared_ptr<char> region, T* ptr, std::size_t count, std::vector<std::size_t> dims)
+    : region(std::move(region))
+    , ptr(ptr)
+    , count(count)
+    , dims(std::move(dims))
+    {
+    }
+
+    std::shared_ptr<char> region;
+    T* ptr = nullptr;
+    std::size_t count = 0;
+    std::vector<std::size_t> dims;
+};
+
+
+
+
+// ============================================================================
+/**
+ * Reads data sets, or hyperslabs of them, in parallel using forked worker
+ * processes, each with its own handle to the file. Since each process has
+ * its own copy of the HDF5 library, the reads are not serialized by its
+ * global lock. Workers read directly into a shared memory segment (memfd),
+ * which the parent exposes without copying through SharedView.
+ *
+ * Requests are registered with add(), and read by run(). The workers are
+ * forked, so they inherit the parent's HDF5 library state, including the
+ * metadata cache of any file it has open. A worker reading a file that is
+ * open in the parent, even read-only, may therefore see stale or partly
+ * written metadata, so run() throws if the file is open anywhere in this
+ * process. No other threads should be making HDF5 calls while run() forks
+ * the workers.
+ */
+class h5::ReaderPool final
+{
+public:
+
+    using Handle = std::size_t;
+
+    ReaderPool(const std::string& filename, unsigned workers)
+    : filename(filename)
+    , workers(std::max(workers, 1u))
+    {
+    }
+
+    template<typename T>
+    Handle add(const std::string& name)
+    {
+        auto dset = planner().open_dataset(name);
+        return add(name, detail::make_datatype_for(T()), dset, detail::hyperslab(), dset.get_space().extent());
+    }
+
+    template<typename T, typename Selector>
+    Handle add(const std::string& name, Selector sel)
+    {
+        auto dset = planner().open_dataset(name);
+        auto extent = dset.get_space().extent();
+        auto slab = detail::hyperslab(nd::with_count(sel, extent.begin(), extent.end()));
+        auto dims = std::vector<std::size_t>(slab.count.begin(), slab.count.end());
+        return add(name, detail::make_datatype_for(T()), dset, slab, dims);
+    }
+
+    void run()
+    {
+        file.close();
+
+        if (open_in_process())
+        {
+            throw std::logic_error("reader pool: " + filename + " is open in this process");
+        }
+        auto total = workers * error_size;
+
+        for (auto& request : requests)
+        {
+            request.offset = total;
+            total += (request.count * request.type.size() + 63) / 64 * 64;
+        }
+
+        auto fd = memfd_create("ndh5-reader-pool", MFD_CLOEXEC);
+
+        if (fd == -1 || ftruncate(fd, total) == -1)
+        {
+            throw std::runtime_error(std::string("reader pool: ") + std::strerror(errno));
+        }
+        auto addr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (addr == MAP_FAILED)
+        {
+            throw std::runtime_error(std::string("reader pool: ") + std::strerror(errno));
+        }
+        region = std::shared_ptr<char>(static_cast<char*>(addr), [total] (char* p) { munmap(p, total); });
+
+        auto pids = std::vector<pid_t>();
+
+        for (unsigned w = 0; w < workers; ++w)
+        {
+            auto pid = fork();
+
+            if (pid == 0)
+            {
+                _exit(work(w));
+            }
+            pids.push_back(pid);
+        }
+
+        auto what = std::string();
+
+        for (unsigned w = 0; w < pids.size(); ++w)
+        {
+            int status = 0;
+
+            if (pids[w] == -1)
+            {
+                what = "reader pool: fork failed";
+            }
+            else if (waitpid(pids[w], &status, 0) == -1)
+            {
+                what = std::string("reader pool: ") + std::strerror(errno);
+            }
+            else if (WIFSIGNALED(status))
+            {
+                what = "reader pool: worker killed by signal " + std::to_string(WTERMSIG(status));
+            }
+            else if (! WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                what = std::string("reader pool: ") + (region.get() + w * error_size);
+            }
+        }
+        if (! what.empty())
+        {
+            throw std::runtime_error(what);
+        }
+    }
+
+    template<typename T>
+    SharedView<T> view(Handle handle) const
+    {
+        const auto& request = requests.at(handle);
+
+        if (! region)
+        {
+            throw std::logic_error("reader pool has not been run");
+        }
+        if (request.type != detail::make_datatype_for(T()))
+        {
+            throw std::invalid_argument("view type differs from the requested type");
+        }
+        auto ptr = reinterpret_cast<T*>(region.get() + request.offset);
+        return SharedView<T>(region, ptr, request.count, request.dims);
+    }
+
+private:
+    // ========================================================================
+    struct Request
+    {
+        std::string name;
+        Datatype type;
+        detail::hyperslab slab;
+        std::vector<std::size_t> dims;
+        std::size_t count = 0;
+        std::size_t offset = 0;
+    };
+
+    /**
+     * Whether any open file handle in this process refers to the file.
+     */
+    bool open_in_process() const
+    {
+        struct stat target;
+
+        if (stat(filename.data(), &target) != 0)
+        {
+            return false;
+        }
+        detail::api_lock lock;
+        auto ids = std::vector<hid_t>(std::size_t(std::max(H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_FILE), ssize_t(0))));
+        ids.resize(std::size_t(std::max(H5Fget_obj_ids(H5F_OBJ_ALL, H5F_OBJ_FILE, ids.size(), ids.data()), ssize_t(0))));
+
+        for (auto id : ids)
+        {
+            auto size = H5Fget_name(id, nullptr, 0);
+            auto name = std::string(std::size_t(std::max(size, ssize_t(0))), '\0');
+            struct stat other;
+
+            if (size > 0 &&
+                H5Fget_name(id, &name[0], name.size() + 1) >= 0 &&
+                stat(name.data(), &other) == 0 &&
+                other.st_dev == target.st_dev &&
+                other.st_ino == target.st_ino)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    File& planner()
+    {
+        if (! file.is_open())
+        {
+            file = File(filename, "r");
+        }
+        return file;
+    }
+
+    Handle add(const std::string& name, const Datatype& type, const Dataset& dset, const detail::hyperslab& slab, const std::vector<std::size_t>& dims)
+    {
+        if (dset.get_type() != type)
+        {
+            throw std::invalid_argument("source and target have different data types");
+        }
+        auto request = Request();
+        request.name = name;
+        request.type = type;
+        request.slab = slab;
+        request.dims = dims;
+        request.count = 1;
+
+        for (auto d : dims)
+        {
+            request.count *= d;
+        }
+        requests.push_back(request);
+        return requests.size() - 1;
+    }
+
+    int work(unsigned w)
+    {
+        // Runs in the child: handles are deliberately not closed, since the
+        // process exits without unwinding.
+        try {
+            auto worker_file = new File(filename, "r");
+
+            for (auto r = w; r < requests.size(); r += workers)
+            {
+                auto& request = requests[r];
+                auto dset = new Dataset(worker_file->open_dataset(request.name));
+                auto fspace = dset->get_space();
+                auto mspace = Dataspace{request.count};
+
+                if (! request.slab.start.empty())
+                {
+                    request.slab.select(fspace.id);
+                }
+                dset->read_raw(region.get() + request.offset, request.type, mspace, fspace);
+            }
+            return 0;
+        }
+        catch (const std::exception& e)
+        {
+            std::strncpy(region.get() + w * error_size, e.what(), error_size - 1);
+            return 1;
+        }
+    }
+
+    static constexpr std::size_t error_size = 256;
+    std::string filename;
+    unsigned workers = 1;
+    File file;
+    std::vector<Request> requests;
+    std::shared_ptr<char> region;
+};
+#endif // __linux__
+
+
+
+
+// ============================================================================
+#ifdef TEST_NDH5
+#include "catch.hpp"
+#include <array>
+#include <fstream>
+#include <numeric>
+#ifdef __linux__
+#include <sys/file.h>
+#endif
+
+
+
+
+SCENARIO("Files can be created", "[h5::File]")
+{
+    GIVEN("A file opened for writing")
+    {
+        auto file = h5::File("test.h5", "w");
+
+        THEN("The file reports being opened with read/write intent")
+        {
+            REQUIRE(file.is_open());
+            REQUIRE(file.intent() == h5::Intent::rdwr);
+        }
+
+        WHEN("The file is closed manually")
+        {
+            file.close();
+
+            THEN("It reports as not open, and can be closed again without effect")
+            {
+                REQUIRE_FALSE(file.is_open());
+                REQUIRE_NOTHROW(file.close());
+            }
+        }
+    }
+
+    GIVEN("A file is opened for reading")
+    {
+        auto file = h5::File("test.h5", "r");
+    
+        THEN("It reports as open with read-only intent")
+        {
+            REQUIRE(file.is_open());
+            REQUIRE(file.intent() == h5::Intent::rdonly);
+        }
+    }
+
+    GIVEN("A filename that does not exist")
+    {
+        THEN("h5::File::exists reports it does not exist, and open as read throws")
+        {
+            REQUIRE_FALSE(h5::File::exists("no-exist.h5"));
+            REQUIRE_THROWS(h5::File("no-exist.h5", "r"));
+        }
+    }
+}
+
+
+SCENARIO("Groups can be created in files", "[h5::Group]")
+{
+    GIVEN("A file opened for writing")
+    {
+        auto file = h5::File("test.h5", "w");
+
+        WHEN("Three groups are created")
+        {
+            auto group1 = file.require_group("group1");
+            auto group2 = file.require_group("group2");
+            auto group3 = file.require_group("group3");
+
+            THEN("file.size() returns 3")
+            {
+                REQUIRE(file.size() == 3);
+            }
+
+            THEN("The groups can be opened without throwing, but a non-existent group does throw")
+            {
+                REQUIRE_NOTHROW(file.open_group("group1"));
+                REQUIRE_NOTHROW(file.open_group("group2"));
+                REQUIRE_NOTHROW(file.open_group("group3"));
+                REQUIRE_THROWS(file.open_group("no-exist"));
+
+                REQUIRE_NOTHROW(file["group1"]);
+                REQUIRE_NOTHROW(file["group1"]["new-group"]); // creates a new group
+            }
+
+            THEN("The groups have the correct names")
             {
                 int n = 0;
 
-                for (auto group : file)
-                {
-                    switch (n++)
-                    {
-                        case 0: REQUIRE(group == "group1"); break;
-                        case 1: REQUIRE(group == "group2"); break;
-                        case 2: REQUIRE(group == "group3"); break;
-                    }
-                }
-            }
+                for (auto group : file)
+                {
+                    switch (n++)
+                    {
+                        case 0: REQUIRE(group == "group1"); break;
+                        case 1: REQUIRE(group == "group2"); break;
+                        case 2: REQUIRE(group == "group3"); break;
+                    }
+                }
+            }
+        }
+
+        WHEN("The file is closed")
+        {
+            file.close();
+
+            THEN("Trying to open a group fails")
+            {
+                REQUIRE_THROWS(file.open_group("group1"));
+            }
+        }
+    }
+}
+
+
+SCENARIO("Data types can be created", "[h5::Datatype]")
+{
+    REQUIRE(h5::detail::make_datatype_for(char()).size() == sizeof(char));
+    REQUIRE(h5::detail::make_datatype_for(int()).size() == sizeof(int));
+    REQUIRE(h5::detail::make_datatype_for(double()).size() == sizeof(double));
+    REQUIRE(h5::detail::make_datatype_for(std::string("message")).size() == 7);
+    REQUIRE(h5::detail::make_datatype_for(std::vector<int>()).size() == sizeof(int));
+}
+
+
+SCENARIO("Data spaces can be created", "[h5::Dataspace]")
+{
+    REQUIRE(h5::Dataspace().size() == 0);
+    REQUIRE(h5::Dataspace::scalar().rank() == 0);
+    REQUIRE(h5::Dataspace::scalar().size() == 1);
+    REQUIRE(h5::Dataspace::scalar().select_all().size() == 1);
+    REQUIRE(h5::Dataspace::scalar().select_none().size() == 1);
+    REQUIRE(h5::Dataspace::scalar().select_all().selection_size() == 1);
+    REQUIRE(h5::Dataspace::scalar().select_none().selection_size() == 0);
+    REQUIRE(h5::Dataspace::simple(std::array<int, 3>{10, 10, 10}).rank() == 3);
+    REQUIRE(h5::Dataspace::simple(std::array<int, 3>{10, 10, 10}).size() == 1000);
+    REQUIRE(h5::Dataspace{10, 21}.size() == 210);
+    REQUIRE(h5::Dataspace{10, 21}.selection_size() == 210);
+    REQUIRE(h5::Dataspace{10, 21}.selection_lower() == std::vector<std::size_t>{0, 0});
+    REQUIRE(h5::Dataspace{10, 21}.selection_upper() == std::vector<std::size_t>{9, 20});
+    REQUIRE_NOTHROW(h5::Dataspace::scalar().select_all());
+
+    GIVEN("A data space constructed from an nd::selector object")
+    {
+        auto sel = nd::selector<2>(100, 100);
+        auto space = h5::Dataspace(sel);
+
+        THEN("The data space and selector have the same size")
+        {
+            REQUIRE(space.size() == sel.size());
+            REQUIRE(space.size() == sel.size());
+            REQUIRE(space.extent() == std::vector<std::size_t>{100, 100});
+            REQUIRE(space.selection_lower() == std::vector<std::size_t>{0, 0});
+            REQUIRE(space.selection_upper() == std::vector<std::size_t>{99, 99});
+            REQUIRE(space.selection_size() == space.size());
+        }
+
+        WHEN("We create another selector as a subset of the larger one")
+        {
+            auto _ = nd::axis::all();
+            auto sub = sel.select(_|0|5, _|0|10);
+
+            THEN("Another data space, with the same extent but smaller size")
+            {
+                auto sub_space = h5::Dataspace(sub);
+
+                REQUIRE(sub_space.extent() == space.extent());
+                REQUIRE(sub_space.selection_lower() == std::vector<std::size_t>{0, 0});
+                REQUIRE(sub_space.selection_upper() == std::vector<std::size_t>{4, 9});
+                REQUIRE(sub_space.selection_size() == sub.size());
+            }
+        }
+    }
+}
+
+
+SCENARIO("Data sets can be created, read, and written to", "[h5::Dataset]")
+{
+    GIVEN("A file opened for writing, native double data type, and a scalar data space")
+    {
+        auto file = h5::File("test.h5", "w");
+        auto type = h5::detail::make_datatype_for(double());
+        auto space = h5::Dataspace::scalar();
+        auto dset = file.require_dataset("data", type, space);
+
+        THEN("The dataset exists in the file with expected properties")
+        {
+            REQUIRE(file.open_dataset("data").get_type() == type);
+            REQUIRE(file.open_dataset("data").get_space().size() == space.size());
+            REQUIRE_NOTHROW(file.open_dataset("data"));
+            REQUIRE_NOTHROW(file.require_dataset("data", type, space));
+            REQUIRE_THROWS(file.require_dataset("data", h5::detail::make_datatype_for(int()), space));
+        }
+    }
+
+    GIVEN("A file opened for writing, native int data type, and a simple data space")
+    {
+        auto file = h5::File("test.h5", "w");
+        auto type = h5::detail::make_datatype_for(int());
+        auto space = h5::Dataspace::simple(std::array<int, 1>{4});
+        auto dset = file.require_dataset("data", type, space);
+
+        THEN("The dataset exists in the file with expected properties")
+        {
+            REQUIRE(file.open_dataset("data").get_type() == type);
+            REQUIRE(file.open_dataset("data").get_space() == space);
+            REQUIRE_NOTHROW(file.open_dataset("data"));
+            REQUIRE_NOTHROW(file.require_dataset("data", type, space));
+            REQUIRE_THROWS(file.require_dataset("data", h5::detail::make_datatype_for(double()), space));
+        }
+
+        WHEN("We have a std::vector<int>{1, 2, 3, 4}")
+        {
+            auto data = std::vector<int>{1, 2, 3, 4};
+
+            THEN("It can be written to the data set and read back")
+            {
+                REQUIRE_NOTHROW(dset.write(data));
+                REQUIRE(dset.read<std::vector<int>>() == data);
+                REQUIRE_THROWS(dset.read<std::vector<double>>());
+                REQUIRE_THROWS(dset.read<double>());
+            }
+        }
+
+        WHEN("We have a std::vector<int>{1, 2, 3} or std::vector<double>{1, 2, 3, 4}")
+        {
+            auto data1 = std::vector<int>{1, 2, 3};
+            auto data2 = std::vector<double>{1, 2, 3, 4};
+
+            THEN("It cannot be written to the data set")
+            {
+                REQUIRE_THROWS(dset.write(data1));
+                REQUIRE_THROWS(dset.write(data2));
+            }
+        }
+    }
+
+    GIVEN("A file opened for writing and a double")
+    {
+        auto data = 10.0;
+        auto file = h5::File("test.h5", "w");
+        auto type = h5::detail::make_datatype_for(data);
+        auto space = h5::Dataspace::scalar();
+        auto dset = file.require_dataset("data", type, space);
+
+        THEN("The double can be written to a scalar dataset")
+        {
+            REQUIRE_NOTHROW(file.require_dataset("data", type, space));
+            REQUIRE_NOTHROW(dset.write(data));
+            REQUIRE(dset.read<double>() == 10.0);
+            REQUIRE_THROWS(dset.read<int>() == 10);
+        }
+    }
+
+    GIVEN("A file opened for writing")
+    {
+        auto data = std::string("The string value");
+        auto file = h5::File("test.h5", "w");
+        auto type = h5::detail::make_datatype_for(data);
+        auto space = h5::Dataspace::scalar();
+        auto dset = file.require_dataset("data1", type, space);
+
+        THEN("A string can be written to a scalar dataset")
+        {
+            REQUIRE_NOTHROW(file.require_dataset("data1", type, space));
+            REQUIRE_NOTHROW(dset.write(data));
+            REQUIRE_THROWS(dset.read<int>());
+            REQUIRE(dset.read<std::string>() == "The string value");
+        }
+
+        WHEN("A string, int, and double are written directly to the file")
+        {
+            file.write("data2", data);
+            file.write("data3", 10.0);
+            file.write("data4", 11);
+
+            THEN("They can be read back out again")
+            {
+                REQUIRE(file.read<std::string>("data2") == data);
+                REQUIRE(file.read<double>("data3") == 10.0);
+                REQUIRE(file.read<int>("data4") == 11);
+            }
+        }
+    }
+
+    GIVEN("A file opened for writing")
+    {
+        auto file = h5::File("test.h5", "w");
+
+        WHEN("An int and double vector are written to it")
+        {
+            auto data1 = std::vector<int>{1, 2, 3, 4};
+            auto data2 = std::vector<double>{1, 2, 3};
+
+            file.write("data1", data1);
+            file.write("data2", data2);
+
+            THEN("They can be read back again")
+            {
+                REQUIRE(file.read<decltype(data1)>("data1") == data1);
+                REQUIRE(file.read<decltype(data2)>("data2") == data2);
+            }
+
+            THEN("Trying to read the wrong type throws")
+            {
+                REQUIRE_THROWS(file.read<decltype(data2)>("data1")); // mismatched data types
+                REQUIRE_THROWS(file.read<decltype(data1)>("data2"));
+            }
+        }
+    }
+}
+
+
+SCENARIO("Data sets can be selected on using ndarray syntax", "[h5::Dataspace] [nd::selector]")
+{
+    using D   = std::vector<double>;
+    auto _    = nd::axis::all();
+    auto file = h5::File("test.h5", "w");
+    auto dset = file.require_dataset<double>("data", {5});
+
+    dset.write(D{0, 1, 2, 3, 4});
+
+    REQUIRE(dset.read<D>(nd::selector<1>(5).slice(0, 2, 1)) == D{0, 1});
+    REQUIRE(dset.read<D>(nd::make_selector(_|0|2)) == D{0, 1});
+    REQUIRE(dset.read<D>(nd::make_selector(_|0|4|2)) == D{0, 2});
+    REQUIRE_THROWS(dset.read<D>(nd::make_selector(_|0|6)));   // out-of-bounds
+    REQUIRE_THROWS(dset.read<D>(nd::make_selector(_|2|8|2))); // out-of-bounds
+    REQUIRE_THROWS(dset.read<D>(nd::make_selector(_, _)));    // wrong rank
+}
+
+
+SCENARIO("nd::ndarray interaction works", "[h5::Dataset] [nd::ndarray]")
+{
+    auto _ = nd::axis::all();
+
+    GIVEN("A file open for writing and a 1D array")
+    {
+        auto file = h5::File("test.h5", "w");
+        auto data = nd::arange<double>(100);
+
+        THEN("The array can be written to the file and read back again")
+        {
+            REQUIRE_NOTHROW(file.write("data", data));
+            REQUIRE((file.read<decltype(data)>("data") == data).all());
+        }
+
+        WHEN("The array is resized to a 2D array")
+        {
+            auto data2 = data.reshape(10, 10);
+
+            THEN("The array can still be written to the file and read back again")
+            {
+                REQUIRE_NOTHROW(file.write("data2", data2));
+                REQUIRE((file.read<decltype(data2)>("data2") == data2).all());
+            }
+
+            THEN("A subset of the 2d array can be written and read back")
+            {
+                auto data3 = data2.select(0, _);
+                REQUIRE_NOTHROW(file.write("data3", data3));
+                REQUIRE((file.read<decltype(data3)>("data3") == data3).all());
+            }
+        }
+    }
+}
+
+SCENARIO("Small adjacent writes can be coalesced", "[h5::BufferedWriter]")
+{
+    using D   = std::vector<double>;
+    auto _    = nd::axis::all();
+    auto file = h5::File("test.h5", "w");
+    auto dset = file.require_dataset<double>("data", {4, 3});
+
+    GIVEN("A buffered writer with a large threshold")
+    {
+        auto writer = dset.buffered<double>();
+
+        WHEN("Rows are written one at a time")
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                writer.write(D{3. * i, 3. * i + 1, 3. * i + 2}, nd::make_selector(_|i|i + 1, _));
+            }
+
+            THEN("Nothing is written until the writer is flushed, and then only once")
+            {
+                REQUIRE(writer.pending() == 12);
+                REQUIRE(writer.flushes() == 0);
+                writer.flush();
+                REQUIRE(writer.pending() == 0);
+                REQUIRE(writer.flushes() == 1);
+                REQUIRE(dset.read<D>() == D{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+            }
+        }
+
+        WHEN("Single elements are written along a row, and then a non-adjacent element")
+        {
+            writer.write(1.0, nd::make_selector(_|1|2, _|0|1));
+            writer.write(2.0, nd::make_selector(_|1|2, _|1|2));
+            writer.write(3.0, nd::make_selector(_|1|2, _|2|3));
+            writer.write(4.0, nd::make_selector(_|3|4, _|0|1));
+
+            THEN("The first run is flushed as one write when the region changes")
+            {
+                REQUIRE(writer.flushes() == 1);
+                REQUIRE(writer.pending() == 1);
+                REQUIRE_THROWS(writer.write(D{1, 2}, nd::make_selector(_|0|1, _)));
+            }
+        }
+    }
+
+    GIVEN("A buffered writer with a threshold of two rows")
+    {
+        WHEN("Four rows are written and the writer goes out of scope")
+        {
+            {
+                auto writer = dset.buffered<double>(6 * sizeof(double));
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    writer.write(D{1, 1, 1}, nd::make_selector(_|i|i + 1, _));
+                }
+                REQUIRE(writer.flushes() == 2);
+            }
+
+            THEN("All of the data was written")
+            {
+                REQUIRE(dset.read<D>() == D(12, 1.0));
+            }
+        }
+    }
+
+    GIVEN("A buffered writer whose flush fails")
+    {
+        auto writer = dset.buffered<int>();
+        writer.write(std::vector<int>{1, 2, 3}, nd::make_selector(_|0|1, _));
+
+        THEN("The failed batch is discarded, and the writer can be flushed again")
+        {
+            REQUIRE_THROWS_AS(writer.flush(), std::invalid_argument);
+            REQUIRE(writer.pending() == 0);
+            REQUIRE(writer.flushes() == 0);
+            REQUIRE_NOTHROW(writer.flush());
+        }
+    }
+}
+
+SCENARIO("Data sets can be read and written asynchronously", "[h5::IOThread]")
+{
+    using D   = std::vector<double>;
+    auto _    = nd::axis::all();
+    auto file = h5::File("test.h5", "w");
+    auto dset = file.require_dataset<double>("data", {4});
+
+    GIVEN("A buffer moved into an asynchronous write")
+    {
+        auto done = dset.write_async(D{1, 2, 3, 4});
+
+        THEN("Reads submitted afterwards see the written data")
+        {
+            auto all = dset.read_async<D>();
+            auto sub = dset.read_async<D>(nd::make_selector(_|1|3));
+            REQUIRE_NOTHROW(done.get());
+            REQUIRE(all.get() == D{1, 2, 3, 4});
+            REQUIRE(sub.get() == D{2, 3});
+        }
+    }
+
+    GIVEN("A pinned buffer, and a buffer of the wrong type")
+    {
+        auto data = D{5, 6};
+        auto good = dset.write_async(std::cref(data), nd::make_selector(_|2|4));
+        auto bad = dset.write_async(std::vector<int>{1, 2, 3, 4});
+
+        THEN("The first write succeeds and the second reports its error through the future")
+        {
+            REQUIRE_NOTHROW(good.get());
+            REQUIRE_THROWS(bad.get());
+            REQUIRE(dset.read<D>(nd::make_selector(_|2|4)) == data);
+        }
+    }
+
+    GIVEN("Writes and reads by name on a group")
+    {
+        auto group = file.require_group("group");
+        auto write = group.write_async("data", D{1, 2, 3});
+        auto read = group.read_async<D>("data");
+        h5::io_thread().wait();
+
+        THEN("The data set is created and read back in order")
+        {
+            REQUIRE_NOTHROW(write.get());
+            REQUIRE(read.get() == D{1, 2, 3});
+            REQUIRE(group.read<D>("data") == D{1, 2, 3});
+        }
+
+        THEN("Writes by name accept a selection")
+        {
+            auto data = D{7, 8, 9};
+            auto moved = group.write_async("data", D{4, 5, 6}, nd::make_selector(_|0|3));
+            auto pinned = group.write_async("more", std::cref(data), nd::make_selector(_|0|3));
+            REQUIRE_NOTHROW(moved.get());
+            REQUIRE_NOTHROW(pinned.get());
+            REQUIRE(group.read<D>("data") == D{4, 5, 6});
+            REQUIRE(group.read<D>("more") == D{7, 8, 9});
+        }
+    }
+}
+
+SCENARIO("Checkpoints are written in the background", "[h5::Checkpoint]")
+{
+    using D = std::vector<double>;
+    auto file = h5::File("test.h5", "w");
+    auto density = D{1, 2, 3};
+    auto step = 0;
+    auto checkpoint = h5::Checkpoint(file);
+
+    auto species = std::vector<std::string>{"H", "He"};
+    auto labels = h5::StringArray({"a", "b"}, 8);
+
+    checkpoint.add("density", density).add("step", step).add("species", species).add("labels", labels);
+
+    WHEN("Two checkpoints are written, modifying the values in between")
+    {
+        checkpoint.write("chkpt.0000");
+        density[0] = 10;
+        step = 1;
+        species[1] = "Helium, a longer string";
+        species.push_back("Li");
+        checkpoint.write("chkpt.0001");
+        species.assign(3, "overwritten");
+        checkpoint.wait();
+
+        THEN("Each checkpoint holds the values at the time it was staged")
+        {
+            REQUIRE(file["chkpt.0000"].read<D>("density") == D{1, 2, 3});
+            REQUIRE(file["chkpt.0000"].read<int>("step") == 0);
+            REQUIRE(file["chkpt.0000"].read<std::vector<std::string>>("species") == std::vector<std::string>{"H", "He"});
+            REQUIRE(file["chkpt.0000"].read<std::vector<std::string>>("labels") == std::vector<std::string>{"a", "b"});
+            REQUIRE(file["chkpt.0001"].read<D>("density") == D{10, 2, 3});
+            REQUIRE(file["chkpt.0001"].read<int>("step") == 1);
+            REQUIRE(file["chkpt.0001"].read<std::vector<std::string>>("species") ==
+                std::vector<std::string>{"H", "Helium, a longer string", "Li"});
+            REQUIRE(checkpoint.last_stall().count() >= 0);
+        }
+    }
+
+    WHEN("A checkpoint is staged while the one before it has not been written")
+    {
+        auto release = std::promise<void>();
+        auto blocked = release.get_future().share();
+        auto busy = h5::io_thread().submit([blocked] { blocked.wait(); });
+
+        auto first = checkpoint.write("chkpt.0000");
+        step = 1;
+        auto second = checkpoint.write("chkpt.0001");
+        auto waiting = first.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+        release.set_value();
+        busy.get();
+        checkpoint.wait();
+
+        THEN("Staging did not wait for the earlier write, and both were written")
+        {
+            REQUIRE(waiting);
+            REQUIRE(second.valid());
+            REQUIRE(file["chkpt.0000"].read<int>("step") == 0);
+            REQUIRE(file["chkpt.0001"].read<int>("step") == 1);
+        }
+    }
+
+    WHEN("A registered array changes size between checkpoints to the same location")
+    {
+        checkpoint.write();
+        density.push_back(4);
+        checkpoint.write();
+
+        THEN("The error is reported by the next wait")
+        {
+            REQUIRE_THROWS(checkpoint.wait());
+            REQUIRE_NOTHROW(checkpoint.wait());
+            REQUIRE(file.read<D>("density") == D{1, 2, 3});
+        }
+    }
+}
+
+SCENARIO("Tiles can be pushed concurrently and written by one consumer", "[h5::TileQueue]")
+{
+    using D   = std::vector<double>;
+    auto _    = nd::axis::all();
+    auto file = h5::File("test.h5", "w");
+    auto dset = file.require_dataset<double>("data", {16, 2});
+    auto queue = dset.tile_queue<double>();
+
+    GIVEN("Four threads, each pushing four rows in reverse order")
+    {
+        auto threads = std::vector<std::thread>();
+
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&queue, _, t]
+            {
+                for (int i = 4 * t + 3; i >= 4 * t; --i)
+                {
+                    queue.push(D{2. * i, 2. * i + 1}, nd::make_selector(_|i|i + 1, _));
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        THEN("The consumer writes all of the rows in a single call")
+        {
+            REQUIRE_FALSE(queue.empty());
+            REQUIRE(queue.drain() == 16);
+            REQUIRE(queue.empty());
+            queue.flush();
+            REQUIRE(queue.flushes() == 1);
+
+            auto expected = D(32);
+            std::iota(expected.begin(), expected.end(), 0.0);
+            REQUIRE(dset.read<D>() == expected);
+        }
+    }
+
+    GIVEN("A tile whose size does not match its selection, among valid rows")
+    {
+        queue.push(D{0., 1.}, nd::make_selector(_|0|1, _));
+        queue.push(D{2., 3., 4.}, nd::make_selector(_|1|2, _));
+        queue.push(D{4., 5.}, nd::make_selector(_|2|3, _));
+
+        THEN("The error is thrown after the valid rows are written")
+        {
+            REQUIRE_THROWS_AS(queue.drain(), std::invalid_argument);
+            REQUIRE(queue.empty());
+            queue.flush();
+
+            auto values = dset.read<D>();
+            REQUIRE(values[0] == 0.);
+            REQUIRE(values[1] == 1.);
+            REQUIRE(values[4] == 4.);
+            REQUIRE(values[5] == 5.);
+        }
+    }
+
+    GIVEN("A tile outside the data set extent, followed by valid rows")
+    {
+        queue.push(D{8., 9.}, nd::make_selector(_|20|21, _));
+        REQUIRE_THROWS_AS(queue.drain(), std::out_of_range);
+        queue.push(D{6., 7.}, nd::make_selector(_|3|4, _));
+        queue.push(D{8., 9.}, nd::make_selector(_|4|5, _));
+
+        THEN("The valid rows are still written")
+        {
+            REQUIRE(queue.drain() == 2);
+            queue.flush();
+
+            auto values = dset.read<D>();
+            REQUIRE(values[6] == 6.);
+            REQUIRE(values[7] == 7.);
+            REQUIRE(values[8] == 8.);
+            REQUIRE(values[9] == 9.);
+        }
+    }
+}
+
+SCENARIO("Calls can be serialized with lock statistics", "[h5::ThreadSafety]")
+{
+    using D   = std::vector<double>;
+    auto file = h5::File("test.h5", "w");
+    file.write("data", D(1000, 1.0));
+
+    REQUIRE(h5::get_thread_safety() == h5::ThreadSafety::automatic);
+#ifdef H5_HAVE_THREADSAFE
+    REQUIRE(h5::library_is_threadsafe());
+#endif
+
+    GIVEN("The serialized mode, and four threads reading the same data set")
+    {
+        h5::set_thread_safety(h5::ThreadSafety::serialized);
+
+        auto dsets = std::vector<h5::Dataset>();
+        auto threads = std::vector<std::thread>();
+
+        for (int t = 0; t < 4; ++t)
+        {
+            dsets.push_back(file.open_dataset("data"));
+        }
+        h5::reset_lock_statistics();
+        dsets[0].read<D>();
+        auto per_read = h5::lock_statistics().acquisitions;
+        h5::reset_lock_statistics();
+
+        for (auto& dset : dsets)
+        {
+            threads.emplace_back([&dset]
+            {
+                for (int i = 0; i < 20; ++i)
+                {
+                    dset.read<D>();
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        auto stats = h5::lock_statistics();
+        h5::set_thread_safety(h5::ThreadSafety::automatic);
+
+        THEN("Each read acquired the lock a fixed number of times, and waiting time is accounted for")
+        {
+            REQUIRE(per_read >= 1);
+            REQUIRE(per_read <= 3);
+            REQUIRE(stats.acquisitions == 80 * per_read);
+            REQUIRE(stats.contentions <= stats.acquisitions);
+            REQUIRE(stats.wait_time >= stats.max_wait);
+        }
+    }
+
+    GIVEN("A group with a long member name")
+    {
+        auto name = std::string(2000, 'a');
+        file.require_group(name);
+
+        THEN("Iteration returns the full name")
+        {
+            REQUIRE(*file.begin() == name);
+        }
+    }
+}
+
+SCENARIO("Data sets accept a transfer mode", "[h5::Dataset] [h5::Transfer]")
+{
+    using D   = std::vector<double>;
+    auto _    = nd::axis::all();
+    auto file = h5::File("test.h5", "w");
+    auto dset = file.require_dataset<double>("data", {4});
+    auto sel  = nd::make_selector(_|1|3);
+
+    REQUIRE_NOTHROW(dset.write(D{1, 2}, sel, h5::Transfer::independent));
+    REQUIRE(dset.read<D>(sel, h5::Transfer::independent) == D{1, 2});
+#ifndef H5_HAVE_PARALLEL
+    REQUIRE_NOTHROW(dset.write(D{3, 4}, sel, h5::Transfer::collective));
+    REQUIRE(dset.read<D>(sel, h5::Transfer::collective) == D{3, 4});
+#endif
+}
+
+SCENARIO("Files support single-writer, multiple-reader access", "[h5::File] [SWMR]")
+{
+    using D   = std::vector<double>;
+    using S   = std::vector<std::size_t>;
+    auto _    = nd::axis::all();
+
+    GIVEN("A writer which has created an extendible data set and started SWMR mode")
+    {
+        auto writer = h5::File("test.h5", "w", h5::FileOptions().latest_format());
+        auto space = h5::Dataspace::simple(S{0}, S{h5::Dataspace::unlimited});
+        auto dset = writer.require_dataset<double>("data", space, h5::DatasetOptions().chunks({4}));
+
+        REQUIRE(space.max_extent() == S{h5::Dataspace::unlimited});
+        REQUIRE_THROWS(h5::File("test.h5", "w", h5::FileOptions().swmr()));
+        REQUIRE_NOTHROW(writer.start_swmr_write());
+        REQUIRE(writer.intent() == h5::Intent::swmr_write);
+
+        dset.resize({2});
+        dset.write(D{1, 2}, nd::make_selector(_|0|2));
+        dset.flush();
+
+        WHEN("A reader opens the file and the writer appends more data")
+        {
+            auto reader = h5::File("test.h5", "r", h5::FileOptions().swmr());
+            auto rdset = reader.open_dataset("data");
+
+            REQUIRE(rdset.get_space().extent() == S{2});
+
+            dset.resize({4});
+            dset.write(D{3, 4}, nd::make_selector(_|2|4));
+            dset.flush();
+
+            THEN("The reader sees the appended data after refreshing")
+            {
+                REQUIRE_NOTHROW(rdset.refresh());
+                REQUIRE(rdset.get_space().extent() == S{4});
+                REQUIRE(rdset.read<D>() == D{1, 2, 3, 4});
+            }
+        }
+    }
+}
+
+SCENARIO("Data sets can be read as byte runs, in parallel", "[h5::Dataset] [h5::ByteRun]")
+{
+    using I   = std::vector<int>;
+    using S   = std::vector<std::size_t>;
+    auto _    = nd::axis::all();
+    auto file = h5::File("test.h5", "w");
+    auto data = I(70);
+    std::iota(data.begin(), data.end(), 0);
+
+    GIVEN("A contiguous and a chunked data set")
+    {
+        auto contiguous = file.require_dataset<int>("contiguous", {10, 7});
+        auto chunked = file.require_dataset<int>("chunked", h5::Dataspace{10, 7}, h5::DatasetOptions().chunks({3, 4}));
+        contiguous.write(data);
+        chunked.write(data);
+
+        THEN("The contiguous data set is a single run, and the chunked one is several")
+        {
+            REQUIRE(contiguous.byte_runs().size() == 1);
+            REQUIRE(contiguous.byte_runs()[0].length == 70 * sizeof(int));
+            REQUIRE(chunked.byte_runs().size() > 1);
+            REQUIRE(chunked.byte_runs(nd::make_selector(_|2|5, _|1|3)).size() == 3);
+        }
+
+        THEN("Parallel reads of any selection agree with ordinary reads")
+        {
+            for (auto dset : {&contiguous, &chunked})
+            {
+                auto sel1 = nd::make_selector(_|1|9, _|2|7);
+                auto sel2 = nd::make_selector(_|0|10|3, _|1|7|2);
+                REQUIRE(dset->read_parallel<I>(4) == data);
+                REQUIRE(dset->read_parallel<I>(sel1, 3) == dset->read<I>(sel1));
+                REQUIRE(dset->read_parallel<I>(sel2, 2) == dset->read<I>(sel2));
+            }
+        }
+    }
+
+    GIVEN("A data set whose storage has not been allocated")
+    {
+        auto dset = file.require_dataset<int>("empty", {4});
+
+        THEN("It has no byte runs, but can be read in parallel with fill values")
+        {
+            REQUIRE_THROWS(dset.byte_runs());
+            REQUIRE(dset.read_parallel<I>(2) == I(4, 0));
+            REQUIRE(dset.get_space().extent() == S{4});
+        }
+    }
+}
+
+SCENARIO("Data sets can be aligned in the file and read into aligned buffers", "[h5::AlignedAllocator]")
+{
+    using A = h5::AlignedVector<double>;
+    auto data = A(10000);
+    std::iota(data.begin(), data.end(), 0.0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(data.data()) % 4096 == 0);
+
+    GIVEN("A file whose objects are aligned to 4096 bytes")
+    {
+        {
+            auto file = h5::File("test.h5", "w", h5::FileOptions().alignment(4096, 1024));
+            file.write("data", data);
+            file.write("more", data);
+        }
+        auto file = h5::File("test.h5", "r");
+
+        THEN("Data sets start on aligned addresses")
+        {
+            REQUIRE(file.open_dataset("data").byte_runs()[0].file_offset % 4096 == 0);
+            REQUIRE(file.open_dataset("more").byte_runs()[0].file_offset % 4096 == 0);
+        }
+
+        THEN("Data sets can be read into aligned vectors")
+        {
+            auto result = file.read<A>("data");
+            REQUIRE(result == data);
+            REQUIRE(reinterpret_cast<std::uintptr_t>(result.data()) % 4096 == 0);
+            REQUIRE(h5::AlignedVector<int, 512>(3).get_allocator() == h5::AlignedAllocator<int, 512>());
+        }
+    }
+
+#ifdef H5_HAVE_DIRECT
+    GIVEN("A file written with the direct I/O driver")
+    {
+        {
+            auto file = h5::File("test.h5", "w", h5::FileOptions().direct_io());
+            file.write("data", data);
+        }
+        THEN("It can be read back with and without the driver")
+        {
+            REQUIRE(h5::File("test.h5", "r", h5::FileOptions().direct_io()).read<A>("data") == data);
+            REQUIRE(h5::File("test.h5", "r").read<A>("data") == data);
+        }
+    }
+#endif
+}
+
+SCENARIO("Files can be split into metadata and raw data files", "[h5::FileOptions] [split]")
+{
+    using D = std::vector<double>;
+    auto data = D(5000);
+    std::iota(data.begin(), data.end(), 0.0);
+
+    GIVEN("A file written with the split driver")
+    {
+        auto meta = h5::FileOptions().block_cache(1 << 20, 4096);
+        auto options = h5::FileOptions().split(".meta", ".raw", meta);
+        {
+            auto file = h5::File("test", "w", options);
+            file.write("data", data);
+            file.require_group("group").write("value", 3);
+        }
+
+        THEN("Both halves exist, and the raw half holds the data")
+        {
+            auto meta_file = std::ifstream("test.meta", std::ios::binary | std::ios::ate);
+            auto raw_file = std::ifstream("test.raw", std::ios::binary | std::ios::ate);
+            REQUIRE(meta_file.good());
+            REQUIRE(raw_file.good());
+            REQUIRE(std::size_t(raw_file.tellg()) >= data.size() * sizeof(double));
+            REQUIRE(std::size_t(meta_file.tellg()) < data.size() * sizeof(double));
+        }
+
+        THEN("The pair can be opened as one file")
+        {
+            auto file = h5::File("test", "r", h5::FileOptions().split(".meta", ".raw"));
+            REQUIRE(file.read<D>("data") == data);
+            REQUIRE(file["group"].read<int>("value") == 3);
+        }
+    }
+}
+
+SCENARIO("Files can be stored as a family of fixed-size members", "[h5::FileOptions] [family]")
+{
+    using D = std::vector<double>;
+    auto data = D(50000);
+    std::iota(data.begin(), data.end(), 0.0);
+
+    GIVEN("A file written with the family driver and 64 KiB members")
+    {
+        {
+            auto file = h5::File("test-%d.h5", "w", h5::FileOptions().family(1 << 16));
+            file.write("data", data);
+        }
+
+        THEN("The data is spread over several members of at most the member size")
+        {
+            auto last = std::ifstream("test-6.h5", std::ios::binary | std::ios::ate);
+            auto first = std::ifstream("test-0.h5", std::ios::binary | std::ios::ate);
+            REQUIRE(last.good());
+            REQUIRE(std::size_t(first.tellg()) == 1 << 16);
+        }
+
+        THEN("The family can be reopened with or without the member size")
+        {
+            REQUIRE(h5::File("test-%d.h5", "r", h5::FileOptions().family(1 << 16)).read<D>("data") == data);
+            REQUIRE(h5::File("test-%d.h5", "r", h5::FileOptions().family()).read<D>("data") == data);
+        }
+
+        THEN("Reopening with a larger member size than the members is an error")
+        {
+            REQUIRE_THROWS_AS(h5::File("test-%d.h5", "r", h5::FileOptions().family(1 << 20)), std::invalid_argument);
+        }
+    }
+}
+
+SCENARIO("A rollover writer appends records to a sequence of files", "[h5::RolloverWriter]")
+{
+    using D = std::vector<double>;
+    using I = std::vector<int>;
+
+    GIVEN("A writer limited to ten records of 20 bytes per file")
+    {
+        std::remove("test-roll-index.h5");
+        {
+            auto writer = h5::RolloverWriter("test-roll", 200);
+            writer.add_dataset<double>("value", 16).add_dataset<int>("count", 16);
+
+            for (int i = 0; i < 25; ++i)
+            {
+                writer.append("value", D{1. * i, 2. * i});
+                writer.append("count", i);
+                writer.commit(100. + i);
+            }
+            REQUIRE(writer.segments() == 3);
+            REQUIRE_THROWS_AS(writer.append("missing", 1), std::invalid_argument);
+            REQUIRE_THROWS_AS(writer.append("count", 1.0), std::invalid_argument);
+            REQUIRE_THROWS_AS(writer.add_dataset<int>("late"), std::logic_error);
+
+            THEN("The index can be read while writing continues")
+            {
+                auto index = h5::File(writer.index_name(), "r");
+                REQUIRE(index.read<D>("start_time") == (D{100, 110}));
+                REQUIRE(index.read<D>("end_time") == (D{109, 119}));
+            }
+        }
+
+        THEN("Every file holds the whole schema and can be read on its own")
+        {
+            auto file = h5::File("test-roll-000001.h5", "r");
+            REQUIRE(file.read<D>("value").size() == 20);
+            REQUIRE(file.read<I>("count") == (I{10, 11, 12, 13, 14, 15, 16, 17, 18, 19}));
+        }
+
+        THEN("The index maps time ranges to files through external links")
+        {
+            auto index = h5::File("test-roll-index.h5", "r");
+            REQUIRE(index.read<D>("start_time") == (D{100, 110, 120}));
+            REQUIRE(index.read<D>("end_time") == (D{109, 119, 124}));
+            REQUIRE(index["segment-000002"].read<I>("count") == (I{20, 21, 22, 23, 24}));
+        }
+    }
+
+    GIVEN("A writer limited to 50 bytes, with records of 20 bytes")
+    {
+        std::remove("test-roll-index.h5");
+        {
+            auto writer = h5::RolloverWriter("test-roll", 50);
+            writer.add_dataset<double>("value").add_dataset<int>("count");
+
+            for (int i = 0; i < 5; ++i)
+            {
+                writer.append("value", D{1. * i, 2. * i});
+                writer.append("count", i);
+                writer.commit(100. + i);
+            }
+            REQUIRE(writer.segments() == 3);
+        }
+
+        THEN("No record is split between files")
+        {
+            for (int n = 0; n < 3; ++n)
+            {
+                auto file = h5::File("test-roll-00000" + std::to_string(n) + ".h5", "r");
+                REQUIRE(file.read<D>("value").size() == 2 * file.read<I>("count").size());
+            }
+            REQUIRE(h5::File("test-roll-000001.h5", "r").read<I>("count") == (I{2, 3}));
+        }
+
+        THEN("A second writer on the same prefix continues the numbering")
+        {
+            {
+                auto writer = h5::RolloverWriter("test-roll", 50);
+                writer.add_dataset<int>("count");
+                writer.append("count", 5);
+                writer.commit(105.);
+                REQUIRE(writer.segments() == 4);
+            }
+            auto index = h5::File("test-roll-index.h5", "r");
+            REQUIRE(index.read<D>("start_time") == (D{100, 102, 104, 105}));
+            REQUIRE(index["segment-000000"].read<I>("count") == (I{0, 1}));
+            REQUIRE(index["segment-000003"].read<I>("count") == (I{5}));
+        }
+    }
+
+    GIVEN("A writer with a short maximum age")
+    {
+        std::remove("test-roll-index.h5");
+        auto writer = h5::RolloverWriter("test-roll", 1 << 20, std::chrono::milliseconds(1));
+        writer.add_dataset<int>("count");
+        writer.append("count", 1);
+        writer.commit();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        writer.append("count", 2);
+        writer.commit();
+
+        THEN("It rolls over when the age is exceeded")
+        {
+            REQUIRE(writer.segments() == 2);
+        }
+    }
+}
+
+SCENARIO("Files can be opened with tuned access options", "[h5::FileOptions]")
+{
+    using D = std::vector<double>;
+    auto data = D(1000);
+    std::iota(data.begin(), data.end(), 0.0);
+
+    GIVEN("Options setting every tuning knob")
+    {
+        auto options = h5::FileOptions()
+        .library_versions(h5::LibraryVersion::v18)
+        .close_degree(h5::CloseDegree::strong)
+        .metadata_cache(1 << 20, 1 << 20, 8 << 20, false)
+        .aggregation(1 << 16, 1 << 16)
+        .sieve_buffer(1 << 18)
+        .alignment(512, 4096);
+#if H5_VERSION_GE(1, 10, 7)
+        options.file_locking(false, true);
+#endif
+
+        THEN("A file can be written and read back with them")
+        {
+            {
+                auto file = h5::File("test.h5", "w", options);
+                file.write("data", data);
+                file.require_group("group").write("value", 5);
+            }
+            auto file = h5::File("test.h5", "r", options);
+            REQUIRE(file.read<D>("data") == data);
+            REQUIRE(file["group"].read<int>("value") == 5);
+        }
+
+        THEN("The opened file reports the options it was opened with")
+        {
+            auto file = h5::File("test.h5", "w", options);
+            REQUIRE(file.library_versions() == std::make_pair(h5::LibraryVersion::v18, h5::LibraryVersion::latest));
+#if H5_VERSION_GE(1, 10, 7) && defined(__linux__)
+            // HDF5 locks with flock, which conflicts with a second open
+            // file description even within one process.
+            auto try_lock = [] (const char* name)
+            {
+                auto fd = ::open(name, O_RDONLY);
+                auto locked = flock(fd, LOCK_SH | LOCK_NB) == 0;
+                ::close(fd);
+                return locked;
+            };
+            auto locked = h5::File("test-locked.h5", "w");
+            REQUIRE(try_lock("test.h5"));
+            REQUIRE_FALSE(try_lock("test-locked.h5"));
+#endif
+            REQUIRE(h5::File("test-earliest.h5", "w", h5::FileOptions().library_versions(
+                h5::LibraryVersion::earliest, h5::LibraryVersion::v18)).library_versions() ==
+                std::make_pair(h5::LibraryVersion::earliest, h5::LibraryVersion::v18));
+        }
+    }
+
+    GIVEN("Inconsistent options")
+    {
+        THEN("They are rejected when set")
+        {
+            REQUIRE_THROWS_AS(h5::FileOptions().library_versions(h5::LibraryVersion::latest, h5::LibraryVersion::earliest), std::invalid_argument);
+            REQUIRE_THROWS_AS(h5::FileOptions().metadata_cache(8 << 20, 1 << 20, 1 << 20), std::invalid_argument);
+        }
+    }
+}
+
+SCENARIO("Large groups can be created with creation order indexing", "[h5::GroupOptions]")
+{
+    GIVEN("A group tracking creation order, with links added in reverse name order")
+    {
+        auto file = h5::File("test.h5", "w");
+        auto options = h5::GroupOptions()
+        .link_phase_change(16, 8)
+        .estimated_links(2000, 8)
+        .track_creation_order();
+        auto group = file.require_group("large", options);
+        auto created = std::vector<std::string>();
+
+        for (int i = 1999; i >= 0; --i)
+        {
+            auto name = "item" + std::to_string(10000 + i);
+            group.write(name, i);
+            created.push_back(name);
+        }
+
+        THEN("Links can be listed by name or in creation order")
+        {
+            auto sorted = created;
+            std::sort(sorted.begin(), sorted.end());
+            REQUIRE(group.size() == 2000);
+            REQUIRE(group.names() == sorted);
+            REQUIRE(group.names(h5::Order::creation) == created);
+            auto iterated = std::vector<std::string>();
+
+            for (auto name : group)
+            {
+                iterated.push_back(name);
+            }
+            std::sort(iterated.begin(), iterated.end());
+            REQUIRE(iterated == sorted);
+            REQUIRE(group.read<int>("item10500") == 500);
+        }
+
+        THEN("Requiring the group again opens it")
+        {
+            REQUIRE(file.require_group("large", h5::GroupOptions()).size() == 2000);
+            REQUIRE(file.names() == std::vector<std::string>{"large"});
+        }
+
+        THEN("Groups that do not track creation order cannot be listed in it")
+        {
+            auto plain = file.require_group("plain");
+            plain.write("a", 1);
+            REQUIRE_THROWS_AS(plain.names(h5::Order::creation), std::invalid_argument);
+        }
+    }
+}
+
+SCENARIO("Groups and data sets can be addressed by multi-component paths", "[h5::Location] [h5::Schema]")
+{
+    using D = std::vector<double>;
+
+    GIVEN("A file written through nested paths")
+    {
+        auto file = h5::File("test.h5", "w");
+        file.write("a/b/c/data", D{1, 2, 3});
+        file["x/y"].write("value", 4);
+
+        THEN("Intermediate groups are created, and paths can be read back")
+        {
+            REQUIRE(file.read<D>("a/b/c/data") == D{1, 2, 3});
+            REQUIRE(file["a"]["b"].read<D>("c/data") == D{1, 2, 3});
+            REQUIRE(file.read<int>("x/y/value") == 4);
+            REQUIRE(file.open_group("a/b").size() == 1);
+        }
+
+        THEN("Paths with missing components are created rather than opened")
+        {
+            REQUIRE(file["a"].require_group("missing/group").size() == 0);
+            REQUIRE(file.require_group("/a/b").size() == 1);
+            REQUIRE(file.open_group("a").size() == 2);
+            REQUIRE_THROWS_AS(file.require_group("a/b/c/data/more"), std::invalid_argument);
+        }
+
+        THEN("Deep paths are looked up without leaving intermediate groups open")
+        {
+            auto groups = H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_GROUP);
+            file.require_group("d/e/f/g/h/i").require_group("j");
+            REQUIRE(file.require_group("/d/e/f/g/h/i/j").size() == 0);
+            REQUIRE(file.require_dataset<double>("d/e/f/g/h/i/j/data", {2}).get_space().size() == 2);
+            REQUIRE(file.require_dataset<double>("d/e/f/g/h/i/j/data", {2}).get_space().size() == 2);
+            REQUIRE(H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_GROUP) == groups);
+        }
+
+        THEN("A schema creates a whole tree, and can be required again")
+        {
+            auto schema = h5::Schema()
+            .dataset<double>("run/2/energy", {10})
+            .group("run/1/detector", h5::GroupOptions().track_creation_order())
+            .dataset<int>("run/1/detector/hits", {5})
+            .dataset<double>("a/b/c/data", {3})
+            .group("run");
+
+            file.require_schema(schema);
+            file.require_schema(schema);
+            REQUIRE(file.open_group("run").size() == 2);
+            REQUIRE(file.open_dataset("run/1/detector/hits").get_space().size() == 5);
+            REQUIRE(file.read<D>("a/b/c/data") == D{1, 2, 3});
+
+            REQUIRE_THROWS_AS(file.require_schema(h5::Schema().dataset<int>("a/b/c/data", {3})), std::invalid_argument);
+        }
+    }
+}
+
+SCENARIO("Files with many small data sets can use minimal object headers", "[h5::DatasetOptions]")
+{
+    auto write_many = [] (const std::string& filename, const h5::FileOptions& file_options, const h5::DatasetOptions& options)
+    {
+        {
+            auto file = h5::File(filename, "w", file_options);
+            auto group = file.require_group("items", h5::GroupOptions().track_times(false));
+
+            for (int i = 0; i < 500; ++i)
+            {
+                auto dset = group.require_dataset<double>(std::to_string(i), {4}, options);
+                dset.write(std::vector<double>{1. * i, 2, 3, 4});
+            }
+        }
+        return std::size_t(std::ifstream(filename, std::ios::binary | std::ios::ate).tellg());
+    };
+
+    GIVEN("The same data sets written with default and with minimal headers")
+    {
+        auto plain = write_many("test.h5", h5::FileOptions(), h5::DatasetOptions());
+        auto options = h5::DatasetOptions().track_times(false);
+#if H5_VERSION_GE(1, 10, 5)
+        options.minimize_header();
+#endif
+        auto minimal = write_many("test-minimal.h5", h5::FileOptions().shared_messages(), options);
+
+        THEN("The file with minimal headers is smaller, and reads the same")
+        {
+            REQUIRE(minimal < plain);
+            auto file = h5::File("test-minimal.h5", "r");
+            REQUIRE(file["items"].read<std::vector<double>>("499") == (std::vector<double>{499, 2, 3, 4}));
+        }
+    }
+}
+
+SCENARIO("Arrays of strings can be written and read", "[h5::StringArray]")
+{
+    using S = std::vector<std::string>;
+    auto _  = nd::axis::all();
+
+    GIVEN("A file with variable and fixed-length string data sets")
+    {
+        auto words = S{"alpha", "", "gamma", "delta-epsilon"};
+        auto fixed = h5::StringArray(S{"ab", "cdef", "g"}, 4);
+        auto file = h5::File("test.h5", "w");
+        file.write("words", words);
+        file.write("fixed", fixed);
+
+        THEN("A string array has one arena with a view of each string")
+        {
+            auto array = h5::StringArray(words);
+            REQUIRE(array.size() == 4);
+            REQUIRE(array.width() == 0);
+            REQUIRE(array[0] == "alpha");
+            REQUIRE(array[1].empty());
+            REQUIRE(array[3].str() == "delta-epsilon");
+            REQUIRE(array.to_vector() == words);
+        }
+
+        THEN("The data sets have the expected string types")
+        {
+            REQUIRE(file.open_dataset("words").get_type().size() == sizeof(char*));
+            REQUIRE(file.open_dataset("fixed").get_type().size() == 4);
+        }
+
+        THEN("Variable-length strings read back into a string array or a vector")
+        {
+            auto array = file.read<h5::StringArray>("words");
+            REQUIRE(array.size() == 4);
+            REQUIRE(array[2] == "gamma");
+            REQUIRE(array.to_vector() == words);
+            REQUIRE(file.read<S>("words") == words);
+            REQUIRE(file.read<S>("words", nd::make_selector(_|1|3)) == S{"", "gamma"});
+        }
+
+        THEN("Variable-length strings are not read as byte runs")
+        {
+            auto dset = file.open_dataset("words");
+            REQUIRE_THROWS(dset.byte_runs());
+            REQUIRE(dset.read_parallel<S>(2) == words);
+            REQUIRE(dset.read_parallel<S>(nd::make_selector(_|2|4), 2) == S{"gamma", "delta-epsilon"});
+        }
+
+        THEN("Fixed-length strings read back without their padding")
+        {
+            auto array = file.read<h5::StringArray>("fixed");
+            REQUIRE(array.width() == 4);
+            REQUIRE(array.to_vector() == S{"ab", "cdef", "g"});
+            REQUIRE(file.read<S>("fixed", nd::make_selector(_|1|2)) == S{"cdef"});
+        }
+
+        THEN("Strings are converted to the format of an existing data set")
+        {
+            file.open_dataset("fixed").write(S{"xy", "z", ""});
+            REQUIRE(file.read<S>("fixed") == S{"xy", "z", ""});
+            REQUIRE_THROWS(file.open_dataset("fixed").write(S{"too-long", "", ""}));
+            file.open_dataset("words").write(h5::StringArray(S{"a", "b", "c", "d"}, 1));
+            REQUIRE(file.read<S>("words") == S{"a", "b", "c", "d"});
+        }
+
+        THEN("Strings cannot be read from or written to a numeric data set")
+        {
+            file.write("numbers", std::vector<int>{1, 2});
+            REQUIRE_THROWS(file.read<S>("numbers"));
+            REQUIRE_THROWS(file.open_dataset("numbers").write(S{"a", "b"}));
+        }
+    }
+}
+
+SCENARIO("Ragged arrays store rows of different lengths", "[h5::RaggedArray]")
+{
+    using I = std::vector<int>;
+    using R = std::vector<I>;
+
+    GIVEN("A file with a ragged array of neighbor lists")
+    {
+        {
+            auto file = h5::File("test.h5", "w");
+            auto ragged = file.require_ragged<int>("neighbors", 4);
+            ragged.append(I{1, 2, 3});
+            ragged.append(R{{}, {4}, {5, 6, 7, 8, 9}});
+            ragged.append_flat(I{10, 11}, {1, 0, 1});
+            REQUIRE_THROWS(ragged.append_flat(I{1}, {2}));
+            REQUIRE_THROWS_AS(file.require_ragged<int>("empty", 0), std::invalid_argument);
+        }
+        auto file = h5::File("test.h5", "r+");
+        auto ragged = file.require_ragged<int>("neighbors");
+
+        THEN("The rows and their sizes are available after reopening")
+        {
+            REQUIRE(ragged.size() == 7);
+            REQUIRE(ragged.values() == 11);
+            REQUIRE(ragged.row_size(3) == 5);
+            REQUIRE(ragged.row(0) == I{1, 2, 3});
+            REQUIRE(ragged.row(1) == I{});
+            REQUIRE(ragged.row(3) == I{5, 6, 7, 8, 9});
+            REQUIRE(ragged.row(6) == I{11});
+            REQUIRE_THROWS_AS(ragged.row(7), std::out_of_range);
+        }
+
+        THEN("A range of rows is read at once")
+        {
+            REQUIRE(ragged.rows(1, 4) == R{{}, {4}, {5, 6, 7, 8, 9}});
+            REQUIRE(ragged.rows(4, 6) == R{{10}, {}});
+            REQUIRE(ragged.rows(2, 2) == R{});
+            REQUIRE(ragged.rows(1, 7, 3) == ragged.rows(1, 7));
+            REQUIRE_THROWS(ragged.rows(3, 8));
+        }
+
+        THEN("More rows can be appended")
+        {
+            ragged.append(I{12, 13});
+            REQUIRE(ragged.size() == 8);
+            REQUIRE(ragged.row(7) == I{12, 13});
+            REQUIRE(file.read<std::vector<std::uint64_t>>("neighbors/offsets").back() == 13);
+        }
+
+        THEN("The array cannot be opened with a different value type")
+        {
+            REQUIRE_THROWS(file.require_ragged<double>("neighbors"));
+        }
+    }
+}
+
+SCENARIO("Sparse matrices are stored in CSR form and read by row ranges", "[h5::SparseMatrix]")
+{
+    using U = std::vector<std::uint64_t>;
+    using D = std::vector<double>;
+
+    GIVEN("A 5 x 4 matrix assembled from triplets in parallel")
+    {
+        auto coo = h5::CooMatrix<double>();
+        coo.rows = 3;
+        coo.cols = 4;
+        coo.push_back(2, 1, 5.0);
+        coo.push_back(0, 3, 1.0);
+        coo.push_back(2, 0, 6.0);
+        coo.push_back(0, 0, 2.0);
+
+        auto block = h5::CsrMatrix<double>();
+        block.rows = 2;
+        block.cols = 4;
+        block.indptr = {0, 1, 1};
+        block.indices = {2};
+        block.data = {7.0};
+
+        {
+            auto file = h5::File("test.h5", "w");
+            auto matrix = file.require_sparse<double>("operator", 4, 2);
+            matrix.append(coo, 2);
+            matrix.append(block);
+            REQUIRE_THROWS(matrix.append(h5::CsrMatrix<double>()));
+
+            auto bad = block;
+            bad.indices = {4};
+            REQUIRE_THROWS_AS(matrix.append(bad), std::invalid_argument);
+            bad = block;
+            bad.rows = 3;
+            bad.indptr = {0, 1, 0, 1};
+            REQUIRE_THROWS_AS(matrix.append(bad), std::invalid_argument);
+            REQUIRE_THROWS_AS(file.require_sparse<double>("empty", 4, 0), std::invalid_argument);
+        }
+        auto file = h5::File("test.h5", "r");
+        auto matrix = file.require_sparse<double>("operator", 4);
+
+        THEN("The triplets are assembled into rows in their original order")
+        {
+            auto csr = coo.to_csr(3);
+            REQUIRE(csr.indptr == U{0, 2, 2, 4});
+            REQUIRE(csr.indices == U{3, 0, 1, 0});
+            REQUIRE(csr.data == D{1.0, 2.0, 5.0, 6.0});
+            coo.push_back(3, 0, 1.0);
+            REQUIRE_THROWS_AS(coo.to_csr(), std::out_of_range);
         }
 
-        WHEN("The file is closed")
+        THEN("Assembly gives the same result with any number of threads")
         {
-            file.close();
+            auto big = h5::CooMatrix<double>();
+            big.rows = 100;
+            big.cols = 100;
 
-            THEN("Trying to open a group fails")
+            for (std::size_t i = 0; i < 20000; ++i)
             {
-                REQUIRE_THROWS(file.open_group("group1"));
+                big.push_back(i * 7919 % 100, i % 100, double(i));
             }
+            auto serial = big.to_csr(1);
+            auto threaded = big.to_csr(4);
+            REQUIRE(serial.indptr == threaded.indptr);
+            REQUIRE(serial.indices == threaded.indices);
+            REQUIRE(serial.data == threaded.data);
+            REQUIRE(serial.indptr[1] == 200);
         }
-    }
-}
 
+        THEN("The dimensions are read back on opening")
+        {
+            REQUIRE(matrix.rows() == 5);
+            REQUIRE(matrix.cols() == 4);
+            REQUIRE(matrix.nnz() == 5);
+            REQUIRE(file.read<U>("operator/shape") == U{5, 4});
+            REQUIRE_THROWS(file.require_sparse<double>("operator", 3));
+            REQUIRE_THROWS(file.require_sparse<int>("operator", 4));
+        }
 
-SCENARIO("Data types can be created", "[h5::Datatype]")
-{
-    REQUIRE(h5::detail::make_datatype_for(char()).size() == sizeof(char));
-    REQUIRE(h5::detail::make_datatype_for(int()).size() == sizeof(int));
-    REQUIRE(h5::detail::make_datatype_for(double()).size() == sizeof(double));
-    REQUIRE(h5::detail::make_datatype_for(std::string("message")).size() == 7);
-    REQUIRE(h5::detail::make_datatype_for(std::vector<int>()).size() == sizeof(int));
+        THEN("A range of rows reads only its slice of the matrix")
+        {
+            auto slab = matrix.read_rows(2, 4, 2);
+            REQUIRE(slab.rows == 2);
+            REQUIRE(slab.indptr == U{0, 2, 3});
+            REQUIRE(slab.indices == U{1, 0, 2});
+            REQUIRE(slab.data == D{5.0, 6.0, 7.0});
+            REQUIRE(matrix.read_rows(1, 2).nnz() == 0);
+            REQUIRE(matrix.read_rows(2, 4).data == slab.data);
+            REQUIRE(matrix.read_rows(2, 4).indices == slab.indices);
+            REQUIRE(matrix.read().indptr == U{0, 2, 2, 4, 5, 5});
+            REQUIRE_THROWS_AS(matrix.read_rows(4, 6), std::out_of_range);
+        }
+    }
 }
 
-
-SCENARIO("Data spaces can be created", "[h5::Dataspace]")
+SCENARIO("Tables append rows in batches and read column projections", "[h5::Table]")
 {
-    REQUIRE(h5::Dataspace().size() == 0);
-    REQUIRE(h5::Dataspace::scalar().rank() == 0);
-    REQUIRE(h5::Dataspace::scalar().size() == 1);
-    REQUIRE(h5::Dataspace::scalar().select_all().size() == 1);
-    REQUIRE(h5::Dataspace::scalar().select_none().size() == 1);
-    REQUIRE(h5::Dataspace::scalar().select_all().selection_size() == 1);
-    REQUIRE(h5::Dataspace::scalar().select_none().selection_size() == 0);
-    REQUIRE(h5::Dataspace::simple(std::array<int, 3>{10, 10, 10}).rank() == 3);
-    REQUIRE(h5::Dataspace::simple(std::array<int, 3>{10, 10, 10}).size() == 1000);
-    REQUIRE(h5::Dataspace{10, 21}.size() == 210);
-    REQUIRE(h5::Dataspace{10, 21}.selection_size() == 210);
-    REQUIRE(h5::Dataspace{10, 21}.selection_lower() == std::vector<std::size_t>{0, 0});
-    REQUIRE(h5::Dataspace{10, 21}.selection_upper() == std::vector<std::size_t>{9, 20});
-    REQUIRE_NOTHROW(h5::Dataspace::scalar().select_all());
+    using D = std::vector<double>;
+    using I = std::vector<int>;
+    using S = std::vector<std::string>;
 
-    GIVEN("A data space constructed from an nd::selector object")
+    GIVEN("A table of events with three columns, written in batches of four rows")
     {
-        auto sel = nd::selector<2>(100, 100);
-        auto space = h5::Dataspace(sel);
+        {
+            auto file = h5::File("test.h5", "w");
+            auto table = file.require_table("events", 4);
+            table.add_column<double>("time").add_column<int>("id").add_column<float>("energy");
 
-        THEN("The data space and selector have the same size")
+            for (int i = 0; i < 10; ++i)
+            {
+                table.append_row(0.5 * i, i, float(i * i));
+            }
+            REQUIRE(table.size() == 8);
+            REQUIRE(table.pending() == 2);
+            REQUIRE_THROWS(table.append_row(1.0, 2));
+            REQUIRE_THROWS(table.append_row(1, 2, 3.f));
+            REQUIRE_THROWS(table.add_column<int>("late"));
+            REQUIRE(table.pending() == 2);
+        }
+        auto file = h5::File("test.h5", "r+");
+        auto table = file.require_table("events");
+
+        THEN("The columns are reopened in the order they were added")
         {
-            REQUIRE(space.size() == sel.size());
-            REQUIRE(space.size() == sel.size());
-            REQUIRE(space.extent() == std::vector<std::size_t>{100, 100});
-            REQUIRE(space.selection_lower() == std::vector<std::size_t>{0, 0});
-            REQUIRE(space.selection_upper() == std::vector<std::size_t>{99, 99});
-            REQUIRE(space.selection_size() == space.size());
+            REQUIRE(table.columns() == S{"time", "id", "energy"});
+            REQUIRE(table.size() == 10);
+            REQUIRE(file.read<I>("events/id") == I{0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
         }
 
-        WHEN("We create another selector as a subset of the larger one")
+        THEN("A single column can be read over a range of rows")
         {
-            auto _ = nd::axis::all();
-            auto sub = sel.select(_|0|5, _|0|10);
+            REQUIRE(table.read<double>("time", 2, 5) == D{1.0, 1.5, 2.0});
+            REQUIRE_THROWS(table.read<int>("time", 0, 1));
+            REQUIRE_THROWS(table.read<double>("no-column", 0, 1));
+            REQUIRE_THROWS_AS(table.read<double>("time", 5, 11), std::out_of_range);
+        }
 
-            THEN("Another data space, with the same extent but smaller size")
-            {
-                auto sub_space = h5::Dataspace(sub);
+        THEN("A projection of some columns is read over a range of rows")
+        {
+            auto rows = table.read_rows(6, 9, {"energy", "id"}, 2);
+            REQUIRE(rows.size() == 3);
+            REQUIRE(rows.columns() == S{"energy", "id"});
+            REQUIRE(rows.get<float>("energy") == std::vector<float>{36, 49, 64});
+            REQUIRE(rows.get<int>("id") == I{6, 7, 8});
+            REQUIRE_THROWS(rows.get<double>("id"));
+            REQUIRE_THROWS(rows.get<double>("time"));
+            REQUIRE(table.read_rows(3, 3).size() == 0);
+            REQUIRE(table.read_rows(0, 10).get<double>("time").back() == 4.5);
+        }
 
-                REQUIRE(sub_space.extent() == space.extent());
-                REQUIRE(sub_space.selection_lower() == std::vector<std::size_t>{0, 0});
-                REQUIRE(sub_space.selection_upper() == std::vector<std::size_t>{4, 9});
-                REQUIRE(sub_space.selection_size() == sub.size());
-            }
+        THEN("Rows appended after reopening are visible to reads")
+        {
+            table.append_row(5.0, 10, 100.f);
+            REQUIRE(table.pending() == 1);
+            REQUIRE(table.read<int>("id", 9, 11) == I{9, 10});
+            REQUIRE(table.pending() == 0);
         }
     }
-}
-
 
-SCENARIO("Data sets can be created, read, and written to", "[h5::Dataset]")
-{
-    GIVEN("A file opened for writing, native double data type, and a scalar data space")
+    GIVEN("A table whose column is stored big-endian")
     {
-        auto file = h5::File("test.h5", "w");
-        auto type = h5::detail::make_datatype_for(double());
-        auto space = h5::Dataspace::scalar();
-        auto dset = file.require_dataset("data", type, space);
+        {
+            auto file = H5Fcreate("test.h5", H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+            auto gcpl = H5Pcreate(H5P_GROUP_CREATE);
+            H5Pset_link_creation_order(gcpl, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED);
+            auto group = H5Gcreate(file, "events", H5P_DEFAULT, gcpl, H5P_DEFAULT);
+            auto dims = hsize_t(3);
+            auto space = H5Screate_simple(1, &dims, nullptr);
+            auto dset = H5Dcreate(group, "time", H5T_IEEE_F64BE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+            auto values = D{0.5, 1.5, 2.5};
+            H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data());
+            H5Dclose(dset);
+            H5Sclose(space);
+            H5Gclose(group);
+            H5Pclose(gcpl);
+            H5Fclose(file);
+        }
+        auto file = h5::File("test.h5", "r");
+        auto table = file.require_table("events");
 
-        THEN("The dataset exists in the file with expected properties")
+        THEN("Its rows are read converted to the native type")
         {
-            REQUIRE(file.open_dataset("data").get_type() == type);
-            REQUIRE(file.open_dataset("data").get_space().size() == space.size());
-            REQUIRE_NOTHROW(file.open_dataset("data"));
-            REQUIRE_NOTHROW(file.require_dataset("data", type, space));
-            REQUIRE_THROWS(file.require_dataset("data", h5::detail::make_datatype_for(int()), space));
+            REQUIRE(table.read_rows(0, 3, {}, 2).get<double>("time") == D{0.5, 1.5, 2.5});
+            REQUIRE(table.read_rows(1, 2).get<double>("time") == D{1.5});
         }
     }
 
-    GIVEN("A file opened for writing, native int data type, and a simple data space")
+    GIVEN("A table reopened in a read-only file")
     {
-        auto file = h5::File("test.h5", "w");
-        auto type = h5::detail::make_datatype_for(int());
-        auto space = h5::Dataspace::simple(std::array<int, 1>{4});
-        auto dset = file.require_dataset("data", type, space);
+        {
+            auto file = h5::File("test.h5", "w");
+            auto table = file.require_table("events", 4);
+            table.add_column<double>("time").add_column<int>("id");
+            table.append_row(0.5, 1);
+            REQUIRE_THROWS_AS(file.require_table("other", 0), std::invalid_argument);
+        }
+        auto file = h5::File("test.h5", "r");
+        auto table = file.require_table("events", 1);
 
-        THEN("The dataset exists in the file with expected properties")
+        THEN("A failed flush keeps the pending rows and leaves the size unchanged")
         {
-            REQUIRE(file.open_dataset("data").get_type() == type);
-            REQUIRE(file.open_dataset("data").get_space() == space);
-            REQUIRE_NOTHROW(file.open_dataset("data"));
-            REQUIRE_NOTHROW(file.require_dataset("data", type, space));
-            REQUIRE_THROWS(file.require_dataset("data", h5::detail::make_datatype_for(double()), space));
+            REQUIRE_THROWS(table.append_row(1.0, 2));
+            REQUIRE(table.size() == 1);
+            REQUIRE(table.pending() == 1);
+            REQUIRE_THROWS(table.flush());
+            REQUIRE(table.pending() == 1);
+            REQUIRE(file.read<I>("events/id") == I{1});
         }
+    }
+}
 
-        WHEN("We have a std::vector<int>{1, 2, 3, 4}")
+SCENARIO("Files can defer metadata writes during a burst", "[h5::BurstMode]")
+{
+    GIVEN("A file in which many groups are created during a burst")
+    {
         {
-            auto data = std::vector<int>{1, 2, 3, 4};
+            auto file = h5::File("test.h5", "w");
+            auto burst = file.burst();
 
-            THEN("It can be written to the data set and read back")
+            for (int i = 0; i < 2000; ++i)
             {
-                REQUIRE_NOTHROW(dset.write(data));
-                REQUIRE(dset.read<std::vector<int>>() == data);
-                REQUIRE_THROWS(dset.read<std::vector<double>>());
-                REQUIRE_THROWS(dset.read<double>());
+                file.require_group("group" + std::to_string(i)).write("value", i);
             }
+            auto moved = std::move(burst);
+            moved.end();
+            moved.end();
+            file.require_group("after").write("value", -1);
         }
 
-        WHEN("We have a std::vector<int>{1, 2, 3} or std::vector<double>{1, 2, 3, 4}")
+        THEN("Every object is written, including those after the burst")
         {
-            auto data1 = std::vector<int>{1, 2, 3};
-            auto data2 = std::vector<double>{1, 2, 3, 4};
-
-            THEN("It cannot be written to the data set")
-            {
-                REQUIRE_THROWS(dset.write(data1));
-                REQUIRE_THROWS(dset.write(data2));
-            }
+            auto file = h5::File("test.h5", "r");
+            REQUIRE(file.size() == 2001);
+            REQUIRE(file["group1999"].read<int>("value") == 1999);
+            REQUIRE(file["after"].read<int>("value") == -1);
         }
     }
 
-    GIVEN("A file opened for writing and a double")
+    GIVEN("A cache size beyond the HDF5 limit")
     {
-        auto data = 10.0;
         auto file = h5::File("test.h5", "w");
-        auto type = h5::detail::make_datatype_for(data);
-        auto space = h5::Dataspace::scalar();
-        auto dset = file.require_dataset("data", type, space);
 
-        THEN("The double can be written to a scalar dataset")
+        THEN("The burst is rejected, and the file is unaffected")
         {
-            REQUIRE_NOTHROW(file.require_dataset("data", type, space));
-            REQUIRE_NOTHROW(dset.write(data));
-            REQUIRE(dset.read<double>() == 10.0);
-            REQUIRE_THROWS(dset.read<int>() == 10);
+            REQUIRE_THROWS_AS(file.burst(std::size_t(1) << 30), std::invalid_argument);
+            file.require_group("group");
+            REQUIRE(file.size() == 1);
         }
     }
+}
 
-    GIVEN("A file opened for writing")
+#if H5_VERSION_GE(1, 10, 1)
+SCENARIO("Files can store an image of their metadata cache", "[h5::FileOptions] [cache_image]")
+{
+    GIVEN("A file with many groups, closed with a cache image")
     {
-        auto data = std::string("The string value");
-        auto file = h5::File("test.h5", "w");
-        auto type = h5::detail::make_datatype_for(data);
-        auto space = h5::Dataspace::scalar();
-        auto dset = file.require_dataset("data1", type, space);
+        {
+            auto file = h5::File("test.h5", "w", h5::FileOptions().metadata_cache_image());
+            REQUIRE(file.metadata_cache_image_size() == 0);
 
-        THEN("A string can be written to a scalar dataset")
+            for (int i = 0; i < 200; ++i)
+            {
+                file.require_group("group" + std::to_string(i)).write("value", i);
+            }
+        }
+
+        THEN("Opening it read-only loads the image and keeps it")
         {
-            REQUIRE_NOTHROW(file.require_dataset("data1", type, space));
-            REQUIRE_NOTHROW(dset.write(data));
-            REQUIRE_THROWS(dset.read<int>());
-            REQUIRE(dset.read<std::string>() == "The string value");
+            REQUIRE(h5::File("test.h5", "r").metadata_cache_image_size() > 0);
+            auto file = h5::File("test.h5", "r");
+            REQUIRE(file.metadata_cache_image_size() > 0);
+            REQUIRE(file["group150"].read<int>("value") == 150);
         }
 
-        WHEN("A string, int, and double are written directly to the file")
+        THEN("Opening it for writing consumes the image")
         {
-            file.write("data2", data);
-            file.write("data3", 10.0);
-            file.write("data4", 11);
+            h5::File("test.h5", "r+").require_group("another");
+            REQUIRE(h5::File("test.h5", "r").metadata_cache_image_size() == 0);
+        }
+    }
 
-            THEN("They can be read back out again")
-            {
-                REQUIRE(file.read<std::string>("data2") == data);
-                REQUIRE(file.read<double>("data3") == 10.0);
-                REQUIRE(file.read<int>("data4") == 11);
-            }
+    GIVEN("Options with the earliest file format")
+    {
+        auto options = h5::FileOptions().library_versions(h5::LibraryVersion::earliest);
+
+        THEN("Enabling the cache image raises the format so the image is written")
+        {
+            h5::File("test.h5", "w", options.metadata_cache_image()).require_group("group");
+            REQUIRE(h5::File("test.h5", "r").metadata_cache_image_size() > 0);
         }
     }
+}
+#endif // H5_VERSION_GE(1, 10, 1)
 
-    GIVEN("A file opened for writing")
+SCENARIO("Files can be opened with the block cache driver", "[h5::FileOptions] [cache]")
+{
+    using D = std::vector<double>;
+    auto big = D(1 << 15);
+    std::iota(big.begin(), big.end(), 0.0);
+
+    GIVEN("A file written through the block cache driver")
     {
-        auto file = h5::File("test.h5", "w");
+        {
+            auto file = h5::File("test.h5", "w", h5::FileOptions().block_cache(1 << 20, 4096, 4));
+            file.write("big", big);
+            file.write("small", D{1, 2, 3});
+            file.require_group("group").write("value", 10);
+            REQUIRE(file.read<D>("big") == big);
+        }
 
-        WHEN("An int and double vector are written to it")
+        THEN("It can be read back with the default driver")
         {
-            auto data1 = std::vector<int>{1, 2, 3, 4};
-            auto data2 = std::vector<double>{1, 2, 3};
+            auto file = h5::File("test.h5", "r");
+            REQUIRE(file.read<D>("big") == big);
+            REQUIRE(file["group"].read<int>("value") == 10);
+            REQUIRE_THROWS_AS(file.cache_statistics(), std::invalid_argument);
+        }
 
-            file.write("data1", data1);
-            file.write("data2", data2);
+        THEN("Reads through the cache are counted, and repeated reads hit")
+        {
+            auto file = h5::File("test.h5", "r", h5::FileOptions().block_cache(1 << 20, 4096, 4));
+            REQUIRE(file.read<D>("big") == big);
+            auto before = file.cache_statistics();
+            REQUIRE(before.misses > 0);
+            REQUIRE(before.bytes_read >= big.size() * sizeof(double));
+
+            REQUIRE(file.read<D>("big") == big);
+            REQUIRE(file.read<D>("small") == D{1, 2, 3});
+            auto after = file.cache_statistics();
+            REQUIRE(after.hits > before.hits);
+            REQUIRE(after.bytes_read == before.bytes_read);
+        }
 
-            THEN("They can be read back again")
-            {
-                REQUIRE(file.read<decltype(data1)>("data1") == data1);
-                REQUIRE(file.read<decltype(data2)>("data2") == data2);
-            }
+        THEN("Sequential slab reads fetch blocks ahead of the requests")
+        {
+            auto file = h5::File("test.h5", "r", h5::FileOptions().block_cache(1 << 20, 4096, 4));
+            auto dset = file.open_dataset("big");
+            auto _ = nd::axis::all();
 
-            THEN("Trying to read the wrong type throws")
+            for (int i = 0; i < 64; ++i)
             {
-                REQUIRE_THROWS(file.read<decltype(data2)>("data1")); // mismatched data types
-                REQUIRE_THROWS(file.read<decltype(data1)>("data2"));
+                auto slab = dset.read<D>(nd::make_selector(_|i * 256|(i + 1) * 256));
+                REQUIRE(slab == D(big.begin() + i * 256, big.begin() + (i + 1) * 256));
             }
+            REQUIRE(file.cache_statistics().read_ahead > 0);
+        }
+
+        THEN("A small cache evicts blocks and still returns the right data")
+        {
+            auto file = h5::File("test.h5", "r", h5::FileOptions().block_cache(16384, 4096, 2));
+            REQUIRE(file.read<D>("big") == big);
+            auto before = file.cache_statistics();
+            REQUIRE(file.read<D>("big") == big);
+            auto after = file.cache_statistics();
+            REQUIRE(after.misses > before.misses);
+            REQUIRE(after.bytes_read > before.bytes_read + big.size() * sizeof(double) / 2);
         }
     }
 }
 
-
-SCENARIO("Data sets can be selected on using ndarray syntax", "[h5::Dataspace] [nd::selector]")
+#ifdef NDH5_HAVE_IO_URING
+SCENARIO("Files can be opened with the io_uring driver", "[h5::FileOptions] [io_uring]")
 {
-    using D   = std::vector<double>;
-    auto _    = nd::axis::all();
-    auto file = h5::File("test.h5", "w");
-    auto dset = file.require_dataset<double>("data", {5});
+    using D = std::vector<double>;
+    auto big = D(1 << 17);
+    std::iota(big.begin(), big.end(), 0.0);
 
-    dset.write(D{0, 1, 2, 3, 4});
+    GIVEN("A file written through the io_uring driver with small blocks")
+    {
+        {
+            auto file = h5::File("test.h5", "w", h5::FileOptions().io_uring_driver(4, 1 << 14));
+            file.write("big", big);
+            file.write("small", D{1, 2, 3});
+            file.require_group("group").write("value", 10);
+        }
 
-    REQUIRE(dset.read<D>(nd::selector<1>(5).slice(0, 2, 1)) == D{0, 1});
-    REQUIRE(dset.read<D>(nd::make_selector(_|0|2)) == D{0, 1});
-    REQUIRE(dset.read<D>(nd::make_selector(_|0|4|2)) == D{0, 2});
-    REQUIRE_THROWS(dset.read<D>(nd::make_selector(_|0|6)));   // out-of-bounds
-    REQUIRE_THROWS(dset.read<D>(nd::make_selector(_|2|8|2))); // out-of-bounds
-    REQUIRE_THROWS(dset.read<D>(nd::make_selector(_, _)));    // wrong rank
+        THEN("It can be read back with the io_uring driver and the default driver")
+        {
+            auto file1 = h5::File("test.h5", "r", h5::FileOptions().io_uring_driver(8, 1 << 12));
+            REQUIRE(file1.read<D>("big") == big);
+            REQUIRE(file1.read<D>("small") == D{1, 2, 3});
+            REQUIRE(file1["group"].read<int>("value") == 10);
+            file1.close();
+
+            auto file2 = h5::File("test.h5", "r");
+            REQUIRE(file2.read<D>("big") == big);
+            REQUIRE(file2.read<D>("small") == D{1, 2, 3});
+        }
+    }
 }
+#endif // NDH5_HAVE_IO_URING
 
-
-SCENARIO("nd::ndarray interaction works", "[h5::Dataset] [nd::ndarray]")
+#ifdef __linux__
+SCENARIO("Data sets can be read in parallel by a pool of worker processes", "[h5::ReaderPool]")
 {
-    auto _ = nd::axis::all();
-
-    GIVEN("A file open for writing and a 1D array")
+    using D = std::vector<double>;
+    using I = std::vector<int>;
+    auto _  = nd::axis::all();
     {
         auto file = h5::File("test.h5", "w");
-        auto data = nd::arange<double>(100);
+        file.write("a", D{1, 2, 3, 4});
+        file.write("b", I{5, 6, 7});
+        file.require_dataset<double>("c", {2, 3}).write(D{0, 1, 2, 3, 4, 5});
+    }
 
-        THEN("The array can be written to the file and read back again")
-        {
-            REQUIRE_NOTHROW(file.write("data", data));
-            REQUIRE((file.read<decltype(data)>("data") == data).all());
-        }
+    GIVEN("A pool of two workers with requests for whole data sets and a hyperslab")
+    {
+        auto pool = h5::ReaderPool("test.h5", 2);
+        auto a = pool.add<double>("a");
+        auto b = pool.add<int>("b");
+        auto c = pool.add<double>("c", nd::make_selector(_|1|2, _|0|2));
 
-        WHEN("The array is resized to a 2D array")
+        REQUIRE_THROWS(pool.add<double>("b"));
+        REQUIRE_THROWS(pool.add<double>("no-exist"));
+        REQUIRE_THROWS(pool.view<double>(a));
+
+        WHEN("The file is open elsewhere in the process")
         {
-            auto data2 = data.reshape(10, 10);
+            auto open = h5::File("test.h5", "r");
 
-            THEN("The array can still be written to the file and read back again")
+            THEN("The pool refuses to fork workers")
             {
-                REQUIRE_NOTHROW(file.write("data2", data2));
-                REQUIRE((file.read<decltype(data2)>("data2") == data2).all());
+                REQUIRE_THROWS_AS(pool.run(), std::logic_error);
             }
+        }
 
-            THEN("A subset of the 2d array can be written and read back")
+        WHEN("The pool is run")
+        {
+            pool.run();
+
+            THEN("The shared views hold the data")
             {
-                auto data3 = data2.select(0, _);
-                REQUIRE_NOTHROW(file.write("data3", data3));
-                REQUIRE((file.read<decltype(data3)>("data3") == data3).all());
+                REQUIRE(pool.view<double>(a).to_vector() == D{1, 2, 3, 4});
+                REQUIRE(pool.view<int>(b).to_vector() == I{5, 6, 7});
+                REQUIRE(pool.view<double>(c).to_vector() == D{3, 4});
+                REQUIRE(pool.view<double>(c).shape() == std::vector<std::size_t>{1, 2});
+                REQUIRE_THROWS(pool.view<int>(a));
             }
         }
     }
 }
+#endif // __linux__
+
+#ifdef H5_HAVE_PARALLEL
+SCENARIO("Files can be opened with the MPI-IO driver", "[h5::File] [MPI]")
+{
+    using D   = std::vector<int>;
+    auto _    = nd::axis::all();
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    GIVEN("A shared file, with one row of a data set per rank")
+    {
+        auto file = h5::File("test-mpi.h5", "w", MPI_COMM_WORLD);
+        auto dset = file.require_dataset<int>("data", {std::size_t(size), 2});
+
+        THEN("Each rank writes its row collectively, and can read the others")
+        {
+            REQUIRE_NOTHROW(dset.write(D{rank, rank}, nd::make_selector(_|rank|rank + 1, _), h5::Transfer::collective));
+            MPI_Barrier(MPI_COMM_WORLD);
+            REQUIRE(dset.read<D>(nd::make_selector(_|0|1, _), h5::Transfer::independent) == D{0, 0});
+        }
+    }
+}
+#endif // H5_HAVE_PARALLEL
 
 #endif // TEST_NDH5